@@ -0,0 +1,232 @@
+/*
+ *  Microbenchmarks for the NodeRedTime paths which run on every call
+ *  to syntheticTime() (ie the paths which do NOT touch the network):
+ *
+ *  1. syntheticTime() when it can extrapolate (the "hit" path).
+ *  2. The recall check which decides whether it can extrapolate.
+ *  3. Parsing a canned Node-Red reply.
+ *  4. Converting uptime (millis) to epoch milliseconds.
+ *  5. Converting epoch seconds to local time (localtime_r).
+ *  6. Issuing record IDs (NodeRedTimeId::next()).
+ *
+ *  Each benchmark is run in batches of increasing size (in the style of
+ *  Google Benchmark) until a batch takes at least MinBatch_us, and the
+ *  per-iteration cost of that batch is reported. Set ReportCycles to
+ *  report CPU cycles per iteration (from the cycle counter) as well as
+ *  nanoseconds.
+ *
+ *  No WiFi is needed. A synchronisation point is injected directly so
+ *  the hit path can be exercised. Works on ESP8266 and ESP32.
+ *
+ *  Created 2026-10-18. MIT License.
+ */
+
+#include <Arduino.h>
+#include <NodeRedTime.h>
+#include <NodeRedTimeId.h>
+
+// Configure for your situation
+const char * TZ_INFO    = "AEST-10AEDT,M10.1.0,M4.1.0/3";
+const bool ReportCycles = true;
+const unsigned long MinBatch_us = 200000;
+
+/*
+ *  A NodeRedTime which exposes the protected hot paths. The URL is
+ *  never contacted.
+ */
+class BenchNodeRedTime : public NodeRedTime {
+
+    public:
+
+        BenchNodeRedTime() : NodeRedTime("http://localhost/time/") { }
+
+        // pretend the server answered at this moment
+        void injectSync(double epoch_ms) {
+            time_t epoch;
+            unsigned long now_ms = millis();
+            acceptSample(epoch_ms, now_ms, now_ms, &epoch);
+        }
+
+        bool recallCheck(double now_ms) {
+            return withinRecall(now_ms);
+        }
+
+        double toEpoch(double uptime_ms) {
+            return uptimeToEpoch_ms(uptime_ms);
+        }
+
+        // run a complete reply through the parser used by pollSync()
+        bool parse(const char * reply) {
+            _replyState = REPLY_STATUS;
+            _lineLength = 0;
+            _contentLength = -1;
+            _bodyLength = 0;
+            while (*reply) {
+                if (!consumeReply(*reply++)) return false;
+            }
+            _line[_lineLength] = '\0';
+            return _replyState == REPLY_BODY;
+        }
+
+};
+
+BenchNodeRedTime nodeRedTime;
+NodeRedTimeId recordIds(nodeRedTime, 1);
+
+// what Node-Red (Express) actually sends
+const char * CannedReply =
+    "HTTP/1.1 200 OK\r\n"
+    "X-Powered-By: Express\r\n"
+    "Access-Control-Allow-Origin: *\r\n"
+    "Content-Type: text/html; charset=utf-8\r\n"
+    "Content-Length: 13\r\n"
+    "ETag: W/\"d-mXZHxG0qZCqk2A2lPeGA7KmM1to\"\r\n"
+    "Date: Wed, 14 Oct 2026 00:00:00 GMT\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n"
+    "1791936000000";
+
+// results are written here so the compiler can't discard the work
+volatile double sink;
+
+
+void benchSyntheticTime(unsigned long n) {
+    time_t epoch;
+    for (unsigned long i = 0; i < n; i++) {
+        nodeRedTime.syntheticTime(&epoch);
+        sink = epoch;
+    }
+}
+
+
+void benchRecallCheck(unsigned long n) {
+    double now_ms = millis();
+    for (unsigned long i = 0; i < n; i++) {
+        sink = nodeRedTime.recallCheck(now_ms + (i & 0xFF));
+    }
+}
+
+
+void benchParseReply(unsigned long n) {
+    for (unsigned long i = 0; i < n; i++) {
+        sink = nodeRedTime.parse(CannedReply);
+    }
+}
+
+
+void benchUptimeToEpoch(unsigned long n) {
+    double now_ms = millis();
+    for (unsigned long i = 0; i < n; i++) {
+        sink = nodeRedTime.toEpoch(now_ms + i);
+    }
+}
+
+
+void benchLocalTime(unsigned long n) {
+    time_t epoch = 1791936000;
+    tm timeinfo;
+    for (unsigned long i = 0; i < n; i++) {
+        epoch += 61;
+        localtime_r(&epoch, &timeinfo);
+        sink = timeinfo.tm_hour;
+    }
+}
+
+
+void benchRecordId(unsigned long n) {
+    uint64_t id;
+    for (unsigned long i = 0; i < n; i++) {
+        recordIds.next(&id);
+        sink = id;
+    }
+}
+
+
+struct Benchmark {
+    const char * name;
+    void (*run)(unsigned long n);
+};
+
+const Benchmark Benchmarks[] = {
+    { "syntheticTime (hit)", benchSyntheticTime },
+    { "recall check",        benchRecallCheck },
+    { "parse reply",         benchParseReply },
+    { "uptime to epoch",     benchUptimeToEpoch },
+    { "localtime_r",         benchLocalTime },
+    { "record ID",           benchRecordId }
+};
+
+
+void runBenchmark(const Benchmark & benchmark) {
+
+    unsigned long n = 1;
+    unsigned long elapsed_us;
+    uint32_t cycles;
+
+    /*
+     *  Grow the batch until it is long enough to time reliably. The
+     *  cycle counter is 32 bits (wraps after ~17 seconds at 240MHz) so
+     *  MinBatch_us must stay well below that.
+     */
+    while (true) {
+
+        yield();
+
+        uint32_t startCycles = ESP.getCycleCount();
+        unsigned long start_us = micros();
+
+        benchmark.run(n);
+
+        elapsed_us = micros() - start_us;
+        cycles = ESP.getCycleCount() - startCycles;
+
+        if (elapsed_us >= MinBatch_us) break;
+
+        n *= 2;
+
+    }
+
+    Serial.printf(
+        "%-22s %12.1f",
+        benchmark.name,
+        1000.0 * elapsed_us / n
+    );
+
+    if (ReportCycles) {
+        Serial.printf(" %12.1f", 1.0 * cycles / n);
+    }
+
+    Serial.printf(" %12lu\n", n);
+
+}
+
+
+void setup() {
+
+    Serial.begin(74880); while (!Serial); Serial.println();
+
+    // inform time.h of the rules for local time conversion
+    setenv("TZ", TZ_INFO, 1);
+    tzset();
+
+    // a plausible synchronisation point (2026-10-14T00:00:00Z)
+    nodeRedTime.injectSync(1791936000000.0);
+
+    Serial.printf("%-22s %12s", "Benchmark", "Time (ns)");
+    if (ReportCycles) {
+        Serial.printf(" %12s", "Cycles");
+    }
+    Serial.printf(" %12s\n", "Iterations");
+
+    for (const Benchmark & benchmark : Benchmarks) {
+        runBenchmark(benchmark);
+    }
+
+}
+
+
+void loop() {
+
+    delay(1000);
+
+}
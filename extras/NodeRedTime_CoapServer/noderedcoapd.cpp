@@ -0,0 +1,715 @@
+/*
+ *  noderedcoapd - a CoAP time responder for NodeRedTime devices.
+ *
+ *  Answers "GET coap://host/time" (the request NodeRedTime sends for a
+ *  coap:// URL) with the current Unix epoch milliseconds as a text
+ *  payload. It stands in for the Node-Red CoAP flow where request
+ *  rates make per-packet cost matter.
+ *
+ *  A request and its reply are each a few dozen bytes, so the cost is
+ *  dominated by system calls rather than by the work done per packet.
+ *  By default each thread therefore receives up to -b requests with
+ *  one recvmmsg() and sends all the replies with one sendmmsg(), using
+ *  message vectors allocated once at start-up. Each reply is stamped
+ *  with the time at which it was built, not once per batch. -b 1 is
+ *  the one-datagram-at-a-time baseline (recvfrom()/sendto()).
+ *
+ *  With several threads (-t), each has its own socket bound to the
+ *  same port with SO_REUSEPORT, so the kernel spreads requests across
+ *  them and no state is shared.
+ *
+ *  Admission control is optional. -c gives each client (by address) a
+ *  token bucket: a burst of ClientBurst requests, then one every -c
+ *  seconds. -r caps the whole server at that many replies a second.
+ *  A request over either limit is answered "5.03 Service Unavailable"
+ *  with a Max-Age option giving the seconds until a token is due, which
+ *  NodeRedTime honours as a back-off (as it does the HTTP flow's 503
+ *  and Retry-After). The kernel sends a given client to the same thread
+ *  every time, so each thread keeps the buckets of its own clients, and
+ *  -r is shared out evenly between the threads.
+ *
+ *  Build:
+ *
+ *      g++ -O2 -std=c++11 -pthread -o noderedcoapd noderedcoapd.cpp
+ *
+ *  Serve:
+ *
+ *      noderedcoapd [-p port] [-t threads] [-b batch] [-u path] [-c seconds] [-r rate]
+ *
+ *  Benchmark (from another machine, or another shell):
+ *
+ *      noderedcoapd -B host [-p port] [-t threads] [-w window] [-d seconds]
+ *
+ *  The benchmark keeps -w requests in flight per thread and reports
+ *  replies per second and the mean round trip (with -w 1, the latency
+ *  of a single request), so compare "-b 1" with the default batch size
+ *  on the server side:
+ *
+ *      noderedcoapd -b 1 &                 # baseline
+ *      noderedcoapd -B 127.0.0.1 -t 4
+ *      kill %1
+ *      noderedcoapd -b 64 &                # batched
+ *      noderedcoapd -B 127.0.0.1 -t 4
+ *
+ *  Options:
+ *
+ *      -p port      UDP port, default 5683
+ *      -t threads   server or benchmark threads, default 1
+ *      -b batch     datagrams per system call (server), default 32
+ *      -u path      resource path, default "time"
+ *      -c seconds   per client: one request this often after a burst,
+ *                   default 0 (no limit)
+ *      -r rate      replies per second for the whole server, default 0
+ *                   (no limit)
+ *      -B host      run the benchmark client against host
+ *      -w window    requests in flight per benchmark thread, default 64
+ *      -d seconds   benchmark duration, default 10
+ *
+ *  Created 2026-10-18. MIT License.
+ */
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// largest datagram accepted (requests are ~20 bytes)
+const size_t DatagramSize = 256;
+
+// CoAP header fields
+const uint8_t CoapVersion = 0x40;
+const uint8_t TypeCON = 0x00;
+const uint8_t TypeNON = 0x10;
+const uint8_t TypeACK = 0x20;
+const uint8_t CodeGET = 0x01;
+const uint8_t CodeContent = 0x45;       // 2.05
+const uint8_t CodeNotFound = 0x84;      // 4.04
+const uint8_t CodeBadMethod = 0x85;     // 4.05
+const uint8_t CodeUnavailable = 0xA3;   // 5.03
+const unsigned OptionUriPath = 11;
+const unsigned OptionContentFormat = 12;
+const unsigned OptionMaxAge = 14;
+
+// admission control: requests a client may make before -c applies,
+// seconds of -r the server may take at once, and clients remembered
+// per thread (a newcomer evicts whoever shares its slot)
+const double ClientBurst = 5;
+const double ServerBurst_s = 2;
+const size_t ClientSlots = 4096;
+
+struct Options {
+    int port = 5683;
+    int threads = 1;
+    int batch = 32;
+    std::string path = "time";
+    const char * benchHost = nullptr;
+    int window = 64;
+    int seconds = 10;
+    double clientInterval_s = 0;
+    double rate = 0;
+};
+
+static Options options;
+
+
+struct Bucket {
+    double tokens;
+    double at;          // monotonicSeconds() of the last refill
+};
+
+
+struct Client {
+    struct in6_addr address;
+    bool used;
+    Bucket bucket;
+};
+
+
+// one thread's buckets, allocated once at start-up
+struct Limiter {
+    std::vector<Client> clients;
+    Bucket server;
+    double serverRate;
+};
+
+
+static int64_t realtimeMillis() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+static double monotonicSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*
+ *  Take a token from bucket, first adding those earned since it was
+ *  last used. Returns zero if one was taken, otherwise the whole
+ *  seconds until one will be there.
+ */
+static unsigned take(Bucket * bucket, double capacity, double rate, double now) {
+
+    bucket->tokens = fmin(capacity, bucket->tokens + (now - bucket->at) * rate);
+    bucket->at = now;
+
+    if (bucket->tokens >= 1) {
+        bucket->tokens -= 1;
+        return 0;
+    }
+
+    return (unsigned)ceil((1 - bucket->tokens) / rate);
+
+}
+
+
+/*
+ *  Admit a request from sender, or return the seconds it should wait.
+ *  A client turned away by the server limit gets its token back, as
+ *  that is not its fault.
+ */
+static unsigned admit(Limiter * limiter, const struct sockaddr_storage * sender) {
+
+    double now = monotonicSeconds();
+    Bucket * client = nullptr;
+
+    if (options.clientInterval_s > 0 && sender->ss_family == AF_INET6) {
+
+        const struct in6_addr & address = ((const struct sockaddr_in6 *)sender)->sin6_addr;
+
+        // FNV-1a of the address picks the slot
+        uint32_t hash = 0x811C9DC5;
+        for (size_t i = 0; i < sizeof(address.s6_addr); i++) {
+            hash = (hash ^ address.s6_addr[i]) * 0x01000193;
+        }
+
+        Client & slot = limiter->clients[hash % ClientSlots];
+        if (!slot.used || memcmp(&slot.address, &address, sizeof(address)) != 0) {
+            slot.address = address;
+            slot.used = true;
+            slot.bucket.tokens = ClientBurst;
+            slot.bucket.at = now;
+        }
+
+        client = &slot.bucket;
+        unsigned wait = take(client, ClientBurst, 1 / options.clientInterval_s, now);
+        if (wait > 0) {
+            return wait;
+        }
+
+    }
+
+    if (limiter->serverRate > 0) {
+
+        double capacity = fmax(1, ServerBurst_s * limiter->serverRate);
+        unsigned wait = take(&limiter->server, capacity, limiter->serverRate, now);
+        if (wait > 0) {
+            if (client) {
+                client->tokens += 1;
+            }
+            return wait;
+        }
+
+    }
+
+    return 0;
+
+}
+
+
+/*
+ *  Build the reply to one request. Returns its length, or zero if
+ *  the datagram should be ignored (not CoAP, or not a request).
+ *
+ *  CON requests get a piggybacked ACK (same message ID), NON requests
+ *  a NON reply. Either way the token is echoed. A request for the time
+ *  which the limiter turns away is answered 5.03 with Max-Age.
+ */
+static size_t answer(
+    const uint8_t * request,
+    size_t length,
+    const struct sockaddr_storage * sender,
+    Limiter * limiter,
+    uint8_t * reply,
+    uint16_t * nextMessageId
+) {
+
+    if (length < 4 || (request[0] & 0xC0) != CoapVersion) {
+        return 0;
+    }
+
+    uint8_t type = request[0] & 0x30;
+    size_t tokenLength = request[0] & 0x0F;
+    uint8_t code = request[1];
+
+    if ((type != TypeCON && type != TypeNON) || tokenLength > 8 || length < 4 + tokenLength) {
+        return 0;
+    }
+
+    // empty messages and responses are not requests
+    if (code == 0 || (code >> 5) != 0) {
+        return 0;
+    }
+
+    // collect the Uri-Path, one segment per option
+    std::string path;
+    size_t i = 4 + tokenLength;
+    unsigned option = 0;
+
+    while (i < length && request[i] != 0xFF) {
+
+        unsigned delta = request[i] >> 4;
+        size_t optionLength = request[i] & 0x0F;
+        i++;
+
+        if (delta == 15 || optionLength == 15) {
+            return 0;
+        }
+        if (delta == 13 && i < length) {
+            delta = 13 + request[i++];
+        } else if (delta == 14 && i + 1 < length) {
+            delta = 269 + ((request[i] << 8) | request[i + 1]);
+            i += 2;
+        }
+        if (optionLength == 13 && i < length) {
+            optionLength = 13 + request[i++];
+        } else if (optionLength == 14 && i + 1 < length) {
+            optionLength = 269 + ((request[i] << 8) | request[i + 1]);
+            i += 2;
+        }
+        if (i + optionLength > length) {
+            return 0;
+        }
+
+        option += delta;
+        if (option == OptionUriPath) {
+            if (!path.empty()) {
+                path += '/';
+            }
+            path.append((const char *)request + i, optionLength);
+        }
+
+        i += optionLength;
+
+    }
+
+    // header: ACK echoes the message ID, NON takes a fresh one
+    size_t n = 0;
+    uint16_t messageId = (request[2] << 8) | request[3];
+    if (type == TypeNON) {
+        messageId = (*nextMessageId)++;
+    }
+
+    uint8_t replyCode =
+        (code != CodeGET) ? CodeBadMethod :
+        (path != options.path) ? CodeNotFound :
+        CodeContent;
+
+    unsigned wait = (replyCode == CodeContent) ? admit(limiter, sender) : 0;
+    if (wait > 0) {
+        replyCode = CodeUnavailable;
+    }
+
+    reply[n++] = CoapVersion | (type == TypeCON ? TypeACK : TypeNON) | tokenLength;
+    reply[n++] = replyCode;
+    reply[n++] = messageId >> 8;
+    reply[n++] = messageId & 0xFF;
+    memcpy(reply + n, request + 4, tokenLength);
+    n += tokenLength;
+
+    if (replyCode == CodeContent) {
+
+        // Content-Format: text/plain (zero-length value), then the payload
+        reply[n++] = OptionContentFormat << 4;
+        reply[n++] = 0xFF;
+        n += snprintf((char *)reply + n, DatagramSize - n, "%lld", (long long)realtimeMillis());
+
+    } else if (replyCode == CodeUnavailable) {
+
+        // Max-Age (delta 14, extended by one byte): the wait, big-endian
+        uint8_t bytes = (wait > 0xFFFFFF) ? 4 : (wait > 0xFFFF) ? 3 : (wait > 0xFF) ? 2 : 1;
+        reply[n++] = (13 << 4) | bytes;
+        reply[n++] = OptionMaxAge - 13;
+        for (int shift = 8 * (bytes - 1); shift >= 0; shift -= 8) {
+            reply[n++] = (wait >> shift) & 0xFF;
+        }
+
+    }
+
+    return n;
+
+}
+
+
+static int bindSocket() {
+
+    int fd = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        exit(1);
+    }
+
+    // every thread binds the same port; the kernel spreads the load
+    int on = 1, off = 0;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+
+    struct sockaddr_in6 address;
+    memset(&address, 0, sizeof(address));
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons(options.port);
+
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        perror("bind");
+        exit(1);
+    }
+
+    return fd;
+
+}
+
+
+// one datagram per system call
+static void serveSingle(int fd, Limiter * limiter) {
+
+    uint8_t request[DatagramSize];
+    uint8_t reply[DatagramSize];
+    uint16_t nextMessageId = rand();
+
+    for (;;) {
+
+        struct sockaddr_storage from;
+        socklen_t fromLength = sizeof(from);
+
+        ssize_t length = recvfrom(fd, request, sizeof(request), 0, (struct sockaddr *)&from, &fromLength);
+        if (length <= 0) {
+            continue;
+        }
+
+        size_t n = answer(request, length, &from, limiter, reply, &nextMessageId);
+        if (n > 0) {
+            sendto(fd, reply, n, 0, (struct sockaddr *)&from, fromLength);
+        }
+
+    }
+
+}
+
+
+// up to options.batch datagrams per system call
+static void serveBatched(int fd, Limiter * limiter) {
+
+    const int batch = options.batch;
+
+    // everything the kernel writes into is allocated once
+    std::vector<uint8_t> requests(batch * DatagramSize);
+    std::vector<uint8_t> replies(batch * DatagramSize);
+    std::vector<struct sockaddr_storage> senders(batch);
+    std::vector<struct iovec> requestVectors(batch);
+    std::vector<struct iovec> replyVectors(batch);
+    std::vector<struct mmsghdr> received(batch);
+    std::vector<struct mmsghdr> sent(batch);
+
+    for (int i = 0; i < batch; i++) {
+        requestVectors[i].iov_base = &requests[i * DatagramSize];
+        requestVectors[i].iov_len = DatagramSize;
+        replyVectors[i].iov_base = &replies[i * DatagramSize];
+    }
+
+    uint16_t nextMessageId = rand();
+
+    for (;;) {
+
+        for (int i = 0; i < batch; i++) {
+            memset(&received[i].msg_hdr, 0, sizeof(received[i].msg_hdr));
+            received[i].msg_hdr.msg_name = &senders[i];
+            received[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+            received[i].msg_hdr.msg_iov = &requestVectors[i];
+            received[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        // block for the first datagram, then take whatever else is queued
+        int count = recvmmsg(fd, received.data(), batch, MSG_WAITFORONE, nullptr);
+        if (count <= 0) {
+            continue;
+        }
+
+        int replyCount = 0;
+
+        for (int i = 0; i < count; i++) {
+
+            uint8_t * reply = &replies[replyCount * DatagramSize];
+            size_t n = answer(
+                &requests[i * DatagramSize], received[i].msg_len, &senders[i],
+                limiter, reply, &nextMessageId
+            );
+
+            if (n == 0) {
+                continue;
+            }
+
+            replyVectors[replyCount].iov_base = reply;
+            replyVectors[replyCount].iov_len = n;
+
+            memset(&sent[replyCount].msg_hdr, 0, sizeof(sent[replyCount].msg_hdr));
+            sent[replyCount].msg_hdr.msg_name = &senders[i];
+            sent[replyCount].msg_hdr.msg_namelen = received[i].msg_hdr.msg_namelen;
+            sent[replyCount].msg_hdr.msg_iov = &replyVectors[replyCount];
+            sent[replyCount].msg_hdr.msg_iovlen = 1;
+
+            replyCount++;
+
+        }
+
+        // sendmmsg() may stop short (eg a full socket buffer)
+        for (int done = 0; done < replyCount; ) {
+            int n = sendmmsg(fd, sent.data() + done, replyCount - done, 0);
+            if (n <= 0) {
+                break;
+            }
+            done += n;
+        }
+
+    }
+
+}
+
+
+static void * serverThread(void *) {
+
+    int fd = bindSocket();
+
+    // the server's rate is shared out between the threads
+    Limiter limiter;
+    limiter.clients.assign(options.clientInterval_s > 0 ? ClientSlots : 0, Client());
+    limiter.serverRate = options.rate / options.threads;
+    limiter.server.tokens = fmax(1, ServerBurst_s * limiter.serverRate);
+    limiter.server.at = monotonicSeconds();
+
+    if (options.batch > 1) {
+        serveBatched(fd, &limiter);
+    } else {
+        serveSingle(fd, &limiter);
+    }
+
+    return nullptr;
+
+}
+
+
+/*
+ *  Benchmark client: keeps options.window NON requests in flight
+ *  on its own socket, topping the window up as replies arrive (and
+ *  every 100ms in case some were lost), and counts replies.
+ */
+static std::atomic<unsigned long> benchReplies(0);
+static std::atomic<bool> benchRunning(true);
+static struct sockaddr_storage benchServer;
+static socklen_t benchServerLength = 0;
+
+
+static void * benchThread(void *) {
+
+    int fd = socket(benchServer.ss_family, SOCK_DGRAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&benchServer, benchServerLength) != 0) {
+        perror("benchmark socket");
+        exit(1);
+    }
+
+    struct timeval tv = { 0, 100000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    // the request NodeRedTime sends: NON, 4-byte token, Uri-Path options
+    std::vector<uint8_t> request = { (uint8_t)(CoapVersion | TypeNON | 4), CodeGET, 0, 0, 1, 2, 3, 4 };
+    size_t start = 0;
+    while (start <= options.path.size()) {
+        size_t end = options.path.find('/', start);
+        if (end == std::string::npos) {
+            end = options.path.size();
+        }
+        size_t length = end - start;
+        request.push_back(((request.size() == 8 ? OptionUriPath : 0) << 4) | (length < 13 ? length : 13));
+        if (length >= 13) {
+            request.push_back(length - 13);
+        }
+        request.insert(request.end(), options.path.begin() + start, options.path.begin() + end);
+        start = end + 1;
+    }
+
+    const int window = options.window;
+    std::vector<struct iovec> vectors(window);
+    std::vector<struct mmsghdr> messages(window);
+    std::vector<uint8_t> buffers(window * DatagramSize);
+
+    int inFlight = 0;
+
+    while (benchRunning) {
+
+        // top up the window with one sendmmsg()
+        int wanted = window - inFlight;
+        for (int i = 0; i < wanted; i++) {
+            vectors[i].iov_base = request.data();
+            vectors[i].iov_len = request.size();
+            memset(&messages[i].msg_hdr, 0, sizeof(messages[i].msg_hdr));
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        if (wanted > 0) {
+            int n = sendmmsg(fd, messages.data(), wanted, 0);
+            inFlight += (n > 0) ? n : 0;
+        }
+
+        // collect replies with one recvmmsg()
+        for (int i = 0; i < window; i++) {
+            vectors[i].iov_base = &buffers[i * DatagramSize];
+            vectors[i].iov_len = DatagramSize;
+            memset(&messages[i].msg_hdr, 0, sizeof(messages[i].msg_hdr));
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        int n = recvmmsg(fd, messages.data(), window, MSG_WAITFORONE, nullptr);
+
+        if (n > 0) {
+            benchReplies += n;
+            inFlight -= n;
+        } else {
+            // timed out - assume the window was lost and refill it
+            inFlight = 0;
+        }
+
+    }
+
+    close(fd);
+    return nullptr;
+
+}
+
+
+static int benchmark() {
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo * address = nullptr;
+    std::string port = std::to_string(options.port);
+
+    if (getaddrinfo(options.benchHost, port.c_str(), &hints, &address) != 0) {
+        fprintf(stderr, "can't resolve %s\n", options.benchHost);
+        return 1;
+    }
+    memcpy(&benchServer, address->ai_addr, address->ai_addrlen);
+    benchServerLength = address->ai_addrlen;
+    freeaddrinfo(address);
+
+    std::vector<pthread_t> threads(options.threads);
+    for (pthread_t & thread : threads) {
+        pthread_create(&thread, nullptr, benchThread, nullptr);
+    }
+
+    // report once a second, then the average
+    double begin = monotonicSeconds();
+    unsigned long previous = 0;
+
+    for (int s = 0; s < options.seconds; s++) {
+        sleep(1);
+        unsigned long total = benchReplies;
+        printf("%8lu replies/s\n", total - previous);
+        fflush(stdout);
+        previous = total;
+    }
+
+    benchRunning = false;
+    for (pthread_t & thread : threads) {
+        pthread_join(thread, nullptr);
+    }
+
+    double elapsed = monotonicSeconds() - begin;
+    double rate = benchReplies / elapsed;
+    printf("average %.0f replies/s over %.1f s (%d threads, window %d)\n",
+        rate, elapsed, options.threads, options.window);
+
+    // Little's law: requests in flight = rate * mean time in flight
+    if (rate > 0) {
+        printf("mean round trip %.1f us\n", 1e6 * options.threads * options.window / rate);
+    }
+
+    return 0;
+
+}
+
+
+static void usage(const char * name) {
+    fprintf(stderr,
+        "usage: %s [-p port] [-t threads] [-b batch] [-u path] [-c seconds] [-r rate]\n"
+        "       %s -B host [-p port] [-t threads] [-w window] [-d seconds] [-u path]\n",
+        name, name);
+    exit(2);
+}
+
+
+int main(int argc, char * argv[]) {
+
+    int option;
+    while ((option = getopt(argc, argv, "p:t:b:u:B:w:d:c:r:")) != -1) {
+        switch (option) {
+            case 'p': options.port = atoi(optarg); break;
+            case 't': options.threads = atoi(optarg); break;
+            case 'b': options.batch = atoi(optarg); break;
+            case 'u': options.path = optarg; break;
+            case 'B': options.benchHost = optarg; break;
+            case 'w': options.window = atoi(optarg); break;
+            case 'd': options.seconds = atoi(optarg); break;
+            case 'c': options.clientInterval_s = atof(optarg); break;
+            case 'r': options.rate = atof(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+
+    if (optind != argc || options.threads < 1 || options.batch < 1 ||
+        options.window < 1 || options.seconds < 1 || options.path.empty() ||
+        options.clientInterval_s < 0 || options.rate < 0) {
+        usage(argv[0]);
+    }
+
+    // the path is compared without leading or trailing slashes
+    while (!options.path.empty() && options.path.front() == '/') {
+        options.path.erase(0, 1);
+    }
+    while (!options.path.empty() && options.path.back() == '/') {
+        options.path.pop_back();
+    }
+
+    if (options.benchHost) {
+        return benchmark();
+    }
+
+    srand(time(nullptr));
+
+    std::vector<pthread_t> threads(options.threads);
+    for (pthread_t & thread : threads) {
+        pthread_create(&thread, nullptr, serverThread, nullptr);
+    }
+    for (pthread_t & thread : threads) {
+        pthread_join(thread, nullptr);
+    }
+
+    return 0;
+
+}
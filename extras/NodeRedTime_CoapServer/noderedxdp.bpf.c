@@ -0,0 +1,211 @@
+/*
+ *  noderedxdp.bpf.c - answer NodeRedTime CoAP requests in XDP.
+ *
+ *  Recognises the exact request NodeRedTime sends for
+ *  "coap://host/time" (IPv4, version 1, CON or NON, GET, 4-byte
+ *  token, a single Uri-Path option "time", no payload), turns the
+ *  frame around in place with the current epoch milliseconds as the
+ *  payload and sends it back out of the interface it arrived on
+ *  (XDP_TX). The network stack never sees it.
+ *
+ *  Everything else - other ports, other paths, IP options, fragments,
+ *  IPv6, malformed requests - is XDP_PASS, so noderedcoapd (or the
+ *  Node-Red CoAP flow) still answers it on the same port.
+ *
+ *  BPF can read CLOCK_MONOTONIC (bpf_ktime_get_ns) but not the wall
+ *  clock, so the loader (noderedxdp.cpp) keeps CLOCK_REALTIME minus
+ *  CLOCK_MONOTONIC in the config map. Slewing by NTP moves both
+ *  clocks; only a step changes the offset, and the loader rewrites
+ *  it every second.
+ *
+ *  Build:
+ *
+ *      clang -O2 -g -target bpf -c noderedxdp.bpf.c -o noderedxdp.bpf.o
+ *
+ *  Created 2026-10-18. MIT License.
+ */
+
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/in.h>
+#include <linux/ip.h>
+#include <linux/udp.h>
+#include <bpf/bpf_endian.h>
+#include <bpf/bpf_helpers.h>
+
+#include "noderedxdp.h"
+
+// the request: header, token, Uri-Path "time"
+#define REQUEST_SIZE 13
+
+// the reply: header, token, Content-Format, marker, 13 digits
+#define REPLY_SIZE 23
+#define DIGITS 13
+
+#define FRAME_SIZE (sizeof(struct ethhdr) + sizeof(struct iphdr) + sizeof(struct udphdr))
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct noderedxdp_config);
+} config SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, NODEREDXDP_COUNTERS);
+    __type(key, __u32);
+    __type(value, __u64);
+} counters SEC(".maps");
+
+
+static __always_inline int count(__u32 counter, int action)
+{
+    __u64 *value = bpf_map_lookup_elem(&counters, &counter);
+
+    if (value) {
+        (*value)++;
+    }
+
+    return action;
+}
+
+
+static __always_inline __u16 ipChecksum(const struct iphdr *ip)
+{
+    const __u16 *word = (const __u16 *)ip;
+    __u32 sum = 0;
+
+    #pragma unroll
+    for (int i = 0; i < (int)(sizeof(*ip) / 2); i++) {
+        sum += word[i];
+    }
+
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+
+    return ~sum;
+}
+
+
+SEC("xdp")
+int noderedxdp(struct xdp_md *ctx)
+{
+    void *data = (void *)(long)ctx->data;
+    void *data_end = (void *)(long)ctx->data_end;
+
+    struct ethhdr *eth = data;
+    if ((void *)(eth + 1) > data_end || eth->h_proto != bpf_htons(ETH_P_IP)) {
+        return XDP_PASS;
+    }
+
+    struct iphdr *ip = (void *)(eth + 1);
+    if ((void *)(ip + 1) > data_end ||
+        ip->ihl != 5 ||
+        ip->protocol != IPPROTO_UDP ||
+        (ip->frag_off & bpf_htons(0x3FFF))) {
+        return XDP_PASS;
+    }
+
+    struct udphdr *udp = (void *)(ip + 1);
+    if ((void *)(udp + 1) > data_end) {
+        return XDP_PASS;
+    }
+
+    __u32 zero = 0;
+    struct noderedxdp_config *cfg = bpf_map_lookup_elem(&config, &zero);
+    if (!cfg || udp->dest != cfg->port) {
+        return XDP_PASS;
+    }
+
+    // for our port: from here on, anything unusual is counted
+    __u8 *coap = (void *)(udp + 1);
+    if ((void *)(coap + REQUEST_SIZE) > data_end ||
+        ip->tot_len != bpf_htons(sizeof(*ip) + sizeof(*udp) + REQUEST_SIZE) ||
+        udp->len != bpf_htons(sizeof(*udp) + REQUEST_SIZE)) {
+        return count(NODEREDXDP_PASSED, XDP_PASS);
+    }
+
+    // version 1, CON (0x40) or NON (0x50), token length 4, GET
+    if ((coap[0] & 0xEF) != 0x44 || coap[1] != 0x01) {
+        return count(NODEREDXDP_PASSED, XDP_PASS);
+    }
+
+    // option delta 11 (Uri-Path), length 4, "time"
+    if (coap[8] != 0xB4 || coap[9] != 't' || coap[10] != 'i' || coap[11] != 'm' || coap[12] != 'e') {
+        return count(NODEREDXDP_PASSED, XDP_PASS);
+    }
+
+    int confirmable = (coap[0] & 0x10) == 0;
+
+    // grow (or, if the frame was padded, shrink) to fit the reply
+    int delta = (int)(FRAME_SIZE + REPLY_SIZE) - (int)(data_end - data);
+    if (bpf_xdp_adjust_tail(ctx, delta)) {
+        return count(NODEREDXDP_PASSED, XDP_PASS);
+    }
+
+    // the helper invalidates every packet pointer
+    data = (void *)(long)ctx->data;
+    data_end = (void *)(long)ctx->data_end;
+
+    if (data + FRAME_SIZE + REPLY_SIZE > data_end) {
+        return XDP_ABORTED;
+    }
+
+    eth = data;
+    ip = (void *)(eth + 1);
+    udp = (void *)(ip + 1);
+    coap = (void *)(udp + 1);
+
+    // back to where it came from
+    __u8 mac[ETH_ALEN];
+    __builtin_memcpy(mac, eth->h_source, ETH_ALEN);
+    __builtin_memcpy(eth->h_source, eth->h_dest, ETH_ALEN);
+    __builtin_memcpy(eth->h_dest, mac, ETH_ALEN);
+
+    __be32 address = ip->saddr;
+    ip->saddr = ip->daddr;
+    ip->daddr = address;
+    ip->ttl = 64;
+    ip->tot_len = bpf_htons(sizeof(*ip) + sizeof(*udp) + REPLY_SIZE);
+    ip->check = 0;
+    ip->check = ipChecksum(ip);
+
+    __be16 port = udp->source;
+    udp->source = udp->dest;
+    udp->dest = port;
+    udp->len = bpf_htons(sizeof(*udp) + REPLY_SIZE);
+    udp->check = 0;             // optional over IPv4
+
+    // stamp as late as possible
+    __u64 now_ns = bpf_ktime_get_ns();
+    __u64 ms = (now_ns + cfg->offset_ns) / 1000000;
+
+    /*
+     *  CON: piggybacked ACK, same message ID. NON: NON reply, which
+     *  needs a message ID of its own - the clients match on the
+     *  token, so any value that varies will do.
+     */
+    coap[0] = 0x44 | (confirmable ? 0x20 : 0x10);
+    coap[1] = 0x45;             // 2.05 Content
+    if (!confirmable) {
+        coap[2] = now_ns >> 18;
+        coap[3] = now_ns >> 10;
+    }
+
+    // token (coap[4..7]) stays as it is
+    coap[8] = 0xC0;             // Content-Format (12): text/plain
+    coap[9] = 0xFF;             // payload marker
+
+    // 13 digits covers epoch milliseconds until the year 2286
+    #pragma unroll
+    for (int i = DIGITS - 1; i >= 0; i--) {
+        coap[10 + i] = '0' + ms % 10;
+        ms /= 10;
+    }
+
+    return count(NODEREDXDP_ANSWERED, XDP_TX);
+}
+
+
+char LICENSE[] SEC("license") = "Dual MIT/GPL";
@@ -0,0 +1,23 @@
+/*
+ *  noderedxdp.h - layout shared by the XDP program and its loader.
+ *
+ *  Created 2026-10-18. MIT License.
+ */
+
+#pragma once
+
+#include <linux/types.h>
+
+// the one entry of the "config" array map, written by the loader
+struct noderedxdp_config {
+    __s64 offset_ns;    // CLOCK_REALTIME - CLOCK_MONOTONIC
+    __u16 port;         // UDP port answered (network byte order)
+    __u16 reserved[3];
+};
+
+// indexes into the per-CPU "counters" array map
+enum noderedxdp_counter {
+    NODEREDXDP_ANSWERED,    // bounced with the time
+    NODEREDXDP_PASSED,      // to the port, but left for userspace
+    NODEREDXDP_COUNTERS
+};
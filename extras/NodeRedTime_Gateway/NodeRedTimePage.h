@@ -0,0 +1,218 @@
+/*
+ *  NodeRedTimePage.h - synthetic time for every process on a gateway.
+ *
+ *  noderedtimed -p /noderedtime publishes its synchronisation state in
+ *  a POSIX shared-memory page (/dev/shm/noderedtime). Any process can
+ *  then compute Node-Red time locally from CLOCK_MONOTONIC, which is
+ *  read through the vDSO, so no system call and no server traffic is
+ *  involved per reading. One synchronisation serves the whole box.
+ *
+ *  The page is a seqlock: the writer makes the sequence number odd,
+ *  updates the fields, then makes it even again. A reader copies the
+ *  fields and retries if the sequence number was odd or changed
+ *  while it was copying. Readers never block the writer.
+ *
+ *  The writer also refreshes a heartbeat (CLOCK_MONOTONIC) at least
+ *  every heartbeatInterval_ms, whether or not the server answers, and
+ *  clears the magic number when it exits. A reader treats a page whose
+ *  heartbeat is older than its maximum age (by default three heartbeat
+ *  intervals) as stale, so a daemon which has died or hung is noticed.
+ *
+ *  A restarted daemon creates a new segment under the same name; a
+ *  mapping of the old one only ever sees the dead page. When now()
+ *  starts failing, call open() again to map the new segment.
+ *
+ *  Sample code:
+ *
+ *      #include "NodeRedTimePage.h"
+ *
+ *      NodeRedTimePageReader page;
+ *      if (page.open("/noderedtime")) {
+ *          int64_t epoch_ns;
+ *          double error_ns;
+ *          if (page.now(&epoch_ns, &error_ns)) {
+ *              ...
+ *          } else {
+ *              page.open("/noderedtime");    // daemon restarted?
+ *          }
+ *      }
+ *
+ *  Link with -lrt on glibc older than 2.17.
+ *
+ *  Created 2026-10-18. MIT License.
+ */
+
+#pragma once
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// the page layout (shared between noderedtimed and readers)
+struct NodeRedTimePage {
+
+    static const uint32_t Magic = 0x4e525450;   // "NRTP"
+    static const uint32_t Version = 2;
+
+    uint32_t magic;             // zero once the writer has exited
+    uint32_t version;
+    uint32_t sequence;          // odd while the writer is updating
+    uint32_t heartbeatInterval_ms;  // longest gap between heartbeats
+
+    // outside the seqlock: written and read atomically on its own
+    int64_t heartbeatMono_ns;   // CLOCK_MONOTONIC at the last heartbeat
+
+    // Node-Red time = anchorEpoch_ns + (mono - anchorMono_ns) * (1 + rate)
+    int64_t anchorMono_ns;      // CLOCK_MONOTONIC at the anchor
+    int64_t anchorEpoch_ns;     // Node-Red time (Unix epoch) at the anchor
+    double rate;                // fractional rate correction (eg 12e-6)
+
+    // error bound = error_ns + |mono - anchorMono_ns| * errorGrowth
+    double error_ns;            // at the anchor
+    double errorGrowth;         // fractional (eg 20e-6)
+
+};
+
+
+// the fields a reader needs, copied out under the seqlock
+struct NodeRedTimeSnapshot {
+    int64_t anchorMono_ns;
+    int64_t anchorEpoch_ns;
+    double rate;
+    double error_ns;
+    double errorGrowth;
+};
+
+
+class NodeRedTimePageReader {
+
+    public:
+
+        NodeRedTimePageReader() { }
+
+        ~NodeRedTimePageReader() {
+            if (_page) {
+                munmap((void *)_page, sizeof(NodeRedTimePage));
+            }
+        }
+
+        NodeRedTimePageReader(const NodeRedTimePageReader &) = delete;
+        NodeRedTimePageReader & operator=(const NodeRedTimePageReader &) = delete;
+
+
+        // map the page read-only (again, after a daemon restart); false if
+        // noderedtimed has not created it
+        bool open(const char * name) {
+
+            if (_page) {
+                munmap((void *)_page, sizeof(NodeRedTimePage));
+                _page = nullptr;
+            }
+
+            int fd = shm_open(name, O_RDONLY, 0);
+            if (fd < 0) {
+                return false;
+            }
+
+            void * mapped = mmap(nullptr, sizeof(NodeRedTimePage), PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+
+            if (mapped == MAP_FAILED) {
+                return false;
+            }
+
+            _page = (const NodeRedTimePage *)mapped;
+            return true;
+
+        }
+
+
+        // true if the writer is running and its heartbeat is at most
+        // maxAge_ns old (zero: three heartbeat intervals)
+        bool alive(int64_t maxAge_ns = 0) const {
+
+            if (!_page ||
+                _page->magic != NodeRedTimePage::Magic ||
+                _page->version != NodeRedTimePage::Version) {
+                return false;
+            }
+
+            if (maxAge_ns <= 0) {
+                maxAge_ns = 3 * 1000000LL * _page->heartbeatInterval_ms;
+            }
+
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            int64_t age_ns = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec -
+                __atomic_load_n(&_page->heartbeatMono_ns, __ATOMIC_ACQUIRE);
+
+            return age_ns <= maxAge_ns;
+
+        }
+
+
+        // consistent copy of the page; false if never published or stale
+        bool snapshot(NodeRedTimeSnapshot * snap, int64_t maxAge_ns = 0) const {
+
+            if (!alive(maxAge_ns)) {
+                return false;
+            }
+
+            for (;;) {
+
+                uint32_t before = __atomic_load_n(&_page->sequence, __ATOMIC_ACQUIRE);
+
+                if (before & 1) {
+                    continue;
+                }
+
+                snap->anchorMono_ns = _page->anchorMono_ns;
+                snap->anchorEpoch_ns = _page->anchorEpoch_ns;
+                snap->rate = _page->rate;
+                snap->error_ns = _page->error_ns;
+                snap->errorGrowth = _page->errorGrowth;
+
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+                if (__atomic_load_n(&_page->sequence, __ATOMIC_RELAXED) == before) {
+                    // zero until the first synchronisation
+                    return before != 0;
+                }
+
+            }
+
+        }
+
+
+        // Node-Red time (Unix epoch nanoseconds) and, optionally, its error
+        // bound; false if not yet published or stale (see alive())
+        bool now(int64_t * epoch_ns, double * error_ns = nullptr, int64_t maxAge_ns = 0) const {
+
+            NodeRedTimeSnapshot snap;
+            if (!snapshot(&snap, maxAge_ns)) {
+                return false;
+            }
+
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            int64_t elapsed_ns = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec - snap.anchorMono_ns;
+
+            *epoch_ns = snap.anchorEpoch_ns + elapsed_ns + (int64_t)(elapsed_ns * snap.rate);
+
+            if (error_ns) {
+                *error_ns = snap.error_ns + (elapsed_ns < 0 ? -elapsed_ns : elapsed_ns) * snap.errorGrowth;
+            }
+
+            return true;
+
+        }
+
+
+    private:
+
+        const NodeRedTimePage * _page = nullptr;
+
+};
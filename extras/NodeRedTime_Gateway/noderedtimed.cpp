@@ -0,0 +1,589 @@
+/*
+ *  noderedtimed - NodeRedTime for Linux gateways.
+ *
+ *  Queries the same Node-Red time service as the microcontrollers and
+ *  publishes the result through the NTP shared-memory reference clock
+ *  (SHM) which both chrony and ntpd can read, so a gateway keeps the
+ *  same time as the devices it serves.
+ *
+ *  Each poll takes several samples and keeps the one with the smallest
+ *  round-trip time: its mid-point estimate is the least affected by
+ *  queueing delay, and half its round trip bounds the error. This is
+ *  the same estimate NodeRedTime::acceptServerTime() makes on a device.
+ *
+ *  Build:
+ *
+ *      g++ -O2 -std=c++11 -o noderedtimed noderedtimed.cpp
+ *
+ *  Run (as root for SHM units 0 and 1, which are created mode 0600):
+ *
+ *      noderedtimed [-u unit] [-n samples] [-i interval_s] http://host:1880/time/
+ *
+ *  then add to /etc/chrony/chrony.conf:
+ *
+ *      refclock SHM 0 refid NRED poll 4 precision 1e-3
+ *
+ *  or to /etc/ntp.conf:
+ *
+ *      server 127.127.28.0
+ *      fudge 127.127.28.0 refid NRED
+ *
+ *  With -p, the daemon also publishes a time page in POSIX shared
+ *  memory from which other processes on the gateway can compute
+ *  Node-Red time without system calls or server traffic of their own
+ *  (see NodeRedTimePage.h). The page carries an anchor, a rate fitted
+ *  over the last HistorySize polls, an error bound, and a heartbeat
+ *  refreshed at least every HeartbeatInterval_ms so readers can tell
+ *  when the daemon has stopped.
+ *
+ *  Only http URLs are supported. Options:
+ *
+ *      -u unit        SHM unit (segment key 0x4e545030 + unit), default 0,
+ *                     -1 to disable
+ *      -p name        also publish a time page (eg /noderedtime)
+ *      -n samples     samples per poll, default 5
+ *      -i interval_s  seconds between polls, default 16
+ *      -v             print each poll's result
+ *
+ *  Created 2026-10-18. MIT License.
+ */
+
+#include <math.h>
+#include <netdb.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <sys/ipc.h>
+#include <sys/mman.h>
+#include <sys/shm.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "NodeRedTimePage.h"
+
+// give up on a sample after this long
+const int SampleTimeout_ms = 2000;
+
+// polls used to fit the rate published in the time page
+const int HistorySize = 8;
+
+// longest gap between time page heartbeats: one sample can take a few
+// SampleTimeout_ms (connect, then each read), and a name lookup longer
+const int HeartbeatInterval_ms = 10000;
+
+// error bound growth when the rate is unknown, and its floor
+const double DefaultGrowth = 20e-6;
+const double MinimumGrowth = 1e-6;
+
+// a jump larger than this (the server's clock was stepped) restarts the fit
+const double StepThreshold_ns = 1e9;
+
+// earliest server time believed (2010-01-01, the library's default minEpoch_s)
+const double MinimumEpoch_ms = 1262304000e3;
+
+// the segment layout shared with chrony and ntpd (refclock_shm.c)
+struct shmTime {
+    int mode;                       // 1 = count/valid protocol
+    volatile int count;
+    time_t clockTimeStampSec;       // true time (from the server)
+    int clockTimeStampUSec;
+    time_t receiveTimeStampSec;     // local system time at that instant
+    int receiveTimeStampUSec;
+    int leap;
+    int precision;                  // log2(seconds)
+    int nsamples;
+    volatile int valid;
+    unsigned clockTimeStampNSec;
+    unsigned receiveTimeStampNSec;
+    int dummy[8];
+};
+
+const key_t SHMKeyBase = 0x4e545030;    // "NTP0"
+
+// one round trip to the server
+struct Sample {
+    double rtt_ns;                  // round-trip time
+    int64_t server_ns;              // server time (Unix epoch)
+    int64_t local_ns;               // CLOCK_REALTIME at the mid-point
+    int64_t mono_ns;                // CLOCK_MONOTONIC at the mid-point
+};
+
+static volatile sig_atomic_t running = 1;
+
+
+static int64_t clockNanos(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+struct Server {
+    std::string host;
+    std::string port = "80";
+    std::string path = "/";
+    struct addrinfo * address = nullptr;
+};
+
+
+// split "http://host[:port][/path]", as the NodeRedTime constructor does
+static bool parseURL(const char * url, Server * server) {
+
+    if (strncasecmp(url, "http://", 7) != 0) {
+        return false;
+    }
+
+    std::string rest(url + 7);
+    size_t slash = rest.find('/');
+    if (slash != std::string::npos) {
+        server->path = rest.substr(slash);
+        rest = rest.substr(0, slash);
+    }
+
+    size_t colon = rest.find(':');
+    if (colon != std::string::npos) {
+        server->port = rest.substr(colon + 1);
+        rest = rest.substr(0, colon);
+    }
+
+    server->host = rest;
+    return !rest.empty();
+
+}
+
+
+/*
+ *  One sample: connect, send a minimal GET, read the reply. The
+ *  round trip is timed from sending the request to the end of the
+ *  body so connection setup is not counted.
+ */
+static bool takeSample(Server & server, Sample * sample) {
+
+    if (!server.address) {
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(server.host.c_str(), server.port.c_str(), &hints, &server.address) != 0) {
+            server.address = nullptr;
+            return false;
+        }
+    }
+
+    int fd = socket(server.address->ai_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct timeval tv = { SampleTimeout_ms / 1000, (SampleTimeout_ms % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    if (connect(fd, server.address->ai_addr, server.address->ai_addrlen) != 0) {
+        close(fd);
+        // the address may have changed - look it up again next time
+        freeaddrinfo(server.address);
+        server.address = nullptr;
+        return false;
+    }
+
+    std::string hostHeader = server.host;
+    if (server.port != "80") {
+        hostHeader += ":" + server.port;
+    }
+    std::string request =
+        "GET " + server.path + " HTTP/1.1\r\n"
+        "Host: " + hostHeader + "\r\n"
+        "Connection: close\r\n\r\n";
+
+    int64_t startMono = clockNanos(CLOCK_MONOTONIC);
+    int64_t startReal = clockNanos(CLOCK_REALTIME);
+
+    if (send(fd, request.data(), request.size(), 0) != (ssize_t)request.size()) {
+        close(fd);
+        return false;
+    }
+
+    // read until Content-Length bytes of body (or close)
+    std::string reply;
+    char buffer[512];
+    long contentLength = -1;
+    size_t bodyStart = std::string::npos;
+
+    for (;;) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n < 0) {
+            // timed out or reset: whatever arrived may be cut short
+            close(fd);
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        reply.append(buffer, n);
+        if (bodyStart == std::string::npos) {
+            size_t blank = reply.find("\r\n\r\n");
+            if (blank != std::string::npos) {
+                bodyStart = blank + 4;
+                const char * header = strcasestr(reply.c_str(), "\r\nContent-Length:");
+                if (header && header < reply.c_str() + blank) {
+                    contentLength = atol(header + 17);
+                }
+            }
+        }
+        if (bodyStart != std::string::npos && contentLength >= 0 &&
+            reply.size() - bodyStart >= (size_t)contentLength) {
+            break;
+        }
+    }
+
+    int64_t endMono = clockNanos(CLOCK_MONOTONIC);
+    int64_t endReal = clockNanos(CLOCK_REALTIME);
+    close(fd);
+
+    // expecting "HTTP/1.x 200 OK" and a body of epoch milliseconds
+    size_t space = reply.find(' ');
+    if (bodyStart == std::string::npos || space == std::string::npos ||
+        atoi(reply.c_str() + space) != 200) {
+        return false;
+    }
+
+    // a body closed short of its Content-Length is a truncated number
+    if (contentLength >= 0 && reply.size() - bodyStart < (size_t)contentLength) {
+        return false;
+    }
+
+    double server_ms = atof(reply.c_str() + bodyStart);
+    if (server_ms < MinimumEpoch_ms) {
+        return false;
+    }
+
+    sample->rtt_ns = (double)(endMono - startMono);
+    sample->server_ns = (int64_t)(server_ms * 1e6);
+    sample->local_ns = startReal + (endReal - startReal) / 2;
+    sample->mono_ns = startMono + (endMono - startMono) / 2;
+
+    return true;
+
+}
+
+
+static struct shmTime * attachSHM(int unit) {
+
+    // units 0 and 1 are root-only, as ntpd and chrony expect
+    int mode = (unit < 2) ? 0600 : 0666;
+    int id = shmget(SHMKeyBase + unit, sizeof(struct shmTime), IPC_CREAT | mode);
+    if (id < 0) {
+        perror("shmget");
+        return nullptr;
+    }
+
+    void * segment = shmat(id, nullptr, 0);
+    if (segment == (void *)-1) {
+        perror("shmat");
+        return nullptr;
+    }
+
+    struct shmTime * shm = (struct shmTime *)segment;
+    memset(shm, 0, sizeof(*shm));
+    shm->mode = 1;
+    shm->nsamples = 3;
+
+    return shm;
+
+}
+
+
+/*
+ *  Mode 1 protocol: the reader copies the segment and discards the
+ *  copy if count changed while it was reading or valid is clear.
+ */
+static void publishSHM(struct shmTime * shm, const Sample & sample) {
+
+    // half the round trip bounds the error; precision is log2(seconds)
+    double bound_s = sample.rtt_ns / 2e9;
+    int precision = (bound_s > 0.0) ? (int)ceil(log2(bound_s)) : -20;
+
+    shm->valid = 0;
+    shm->count++;
+    __sync_synchronize();
+
+    shm->clockTimeStampSec = sample.server_ns / 1000000000;
+    shm->clockTimeStampNSec = sample.server_ns % 1000000000;
+    shm->clockTimeStampUSec = shm->clockTimeStampNSec / 1000;
+    shm->receiveTimeStampSec = sample.local_ns / 1000000000;
+    shm->receiveTimeStampNSec = sample.local_ns % 1000000000;
+    shm->receiveTimeStampUSec = shm->receiveTimeStampNSec / 1000;
+    shm->leap = 0;
+    shm->precision = precision;
+
+    __sync_synchronize();
+    shm->count++;
+    shm->valid = 1;
+
+}
+
+
+static NodeRedTimePage * createPage(const char * name) {
+
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("shm_open");
+        return nullptr;
+    }
+
+    if (ftruncate(fd, sizeof(NodeRedTimePage)) != 0) {
+        perror("ftruncate");
+        close(fd);
+        return nullptr;
+    }
+
+    void * mapped = mmap(nullptr, sizeof(NodeRedTimePage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapped == MAP_FAILED) {
+        perror("mmap");
+        return nullptr;
+    }
+
+    // sequence zero tells readers nothing has been published yet
+    NodeRedTimePage * page = (NodeRedTimePage *)mapped;
+    memset(page, 0, sizeof(*page));
+    page->heartbeatInterval_ms = HeartbeatInterval_ms;
+    page->heartbeatMono_ns = clockNanos(CLOCK_MONOTONIC);
+    page->version = NodeRedTimePage::Version;
+    __atomic_store_n(&page->magic, NodeRedTimePage::Magic, __ATOMIC_RELEASE);
+
+    return page;
+
+}
+
+
+// tell readers the daemon is still running (if there is a page)
+static void heartbeat(NodeRedTimePage * page) {
+
+    if (page) {
+        __atomic_store_n(&page->heartbeatMono_ns, clockNanos(CLOCK_MONOTONIC), __ATOMIC_RELEASE);
+    }
+
+}
+
+
+/*
+ *  Seqlock write: readers retry while the sequence number is odd
+ *  or if it changed while they were copying.
+ */
+static void publishPage(NodeRedTimePage * page, const NodeRedTimeSnapshot & snap) {
+
+    uint32_t sequence = page->sequence;
+
+    __atomic_store_n(&page->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    page->anchorMono_ns = snap.anchorMono_ns;
+    page->anchorEpoch_ns = snap.anchorEpoch_ns;
+    page->rate = snap.rate;
+    page->error_ns = snap.error_ns;
+    page->errorGrowth = snap.errorGrowth;
+
+    __atomic_store_n(&page->sequence, sequence + 2, __ATOMIC_RELEASE);
+
+}
+
+
+/*
+ *  Least-squares fit of (server - monotonic) against monotonic over
+ *  the retained polls. The slope is the rate correction; the scatter
+ *  about the line over the span of the history bounds its error.
+ */
+static NodeRedTimeSnapshot fitHistory(const Sample * history, int count) {
+
+    const Sample & latest = history[count - 1];
+
+    NodeRedTimeSnapshot snap;
+    snap.anchorMono_ns = latest.mono_ns;
+    snap.anchorEpoch_ns = latest.server_ns;
+    snap.rate = 0.0;
+    snap.error_ns = latest.rtt_ns / 2.0;
+    snap.errorGrowth = DefaultGrowth;
+
+    if (count < 2) {
+        return snap;
+    }
+
+    // work relative to the latest poll to keep the doubles small
+    double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+    for (int i = 0; i < count; i++) {
+        double x = history[i].mono_ns - latest.mono_ns;
+        double y = (history[i].server_ns - history[i].mono_ns) - (latest.server_ns - latest.mono_ns);
+        sx += x; sy += y; sxx += x * x; sxy += x * y;
+    }
+
+    double d = count * sxx - sx * sx;
+    if (d <= 0.0) {
+        return snap;
+    }
+
+    double slope = (count * sxy - sx * sy) / d;
+    double intercept = (sy - slope * sx) / count;
+
+    double residuals = 0.0;
+    for (int i = 0; i < count; i++) {
+        double x = history[i].mono_ns - latest.mono_ns;
+        double y = (history[i].server_ns - history[i].mono_ns) - (latest.server_ns - latest.mono_ns);
+        residuals += (y - intercept - slope * x) * (y - intercept - slope * x);
+    }
+    double rms = sqrt(residuals / count);
+    double span = latest.mono_ns - history[0].mono_ns;
+
+    snap.anchorEpoch_ns = latest.server_ns + (int64_t)intercept;
+    snap.rate = slope;
+    snap.error_ns = latest.rtt_ns / 2.0 + fabs(intercept);
+    snap.errorGrowth = MinimumGrowth + 2.0 * rms / span;
+
+    return snap;
+
+}
+
+
+static void stop(int) {
+    running = 0;
+}
+
+
+static void usage(const char * name) {
+    fprintf(stderr, "usage: %s [-u unit] [-p name] [-n samples] [-i interval_s] [-v] http://host:port/path\n", name);
+    exit(2);
+}
+
+
+int main(int argc, char * argv[]) {
+
+    int unit = 0;
+    int samples = 5;
+    int interval_s = 16;
+    const char * pageName = nullptr;
+    bool verbose = false;
+
+    int option;
+    while ((option = getopt(argc, argv, "u:p:n:i:v")) != -1) {
+        switch (option) {
+            case 'u': unit = atoi(optarg); break;
+            case 'p': pageName = optarg; break;
+            case 'n': samples = atoi(optarg); break;
+            case 'i': interval_s = atoi(optarg); break;
+            case 'v': verbose = true; break;
+            default: usage(argv[0]);
+        }
+    }
+
+    Server server;
+    if (optind != argc - 1 || !parseURL(argv[optind], &server) ||
+        unit < -1 || samples < 1 || interval_s < 1 || (unit < 0 && !pageName)) {
+        usage(argv[0]);
+    }
+
+    struct shmTime * shm = nullptr;
+    if (unit >= 0 && !(shm = attachSHM(unit))) {
+        return 1;
+    }
+
+    NodeRedTimePage * page = nullptr;
+    if (pageName && !(page = createPage(pageName))) {
+        return 1;
+    }
+
+    Sample history[HistorySize];
+    int historyCount = 0;
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    while (running) {
+
+        // keep the sample with the smallest round trip
+        Sample best = { 0.0, 0, 0, 0 };
+        bool found = false;
+
+        for (int i = 0; i < samples && running; i++) {
+            Sample sample;
+            if (takeSample(server, &sample) && (!found || sample.rtt_ns < best.rtt_ns)) {
+                best = sample;
+                found = true;
+            }
+            heartbeat(page);
+        }
+
+        if (found) {
+
+            if (shm) {
+                publishSHM(shm, best);
+            }
+
+            if (page) {
+
+                // restart the fit if the server's clock has been stepped
+                if (historyCount > 0) {
+                    NodeRedTimeSnapshot predicted = fitHistory(history, historyCount);
+                    double elapsed_ns = best.mono_ns - predicted.anchorMono_ns;
+                    double expected_ns = predicted.anchorEpoch_ns + elapsed_ns * (1.0 + predicted.rate);
+                    if (fabs(best.server_ns - expected_ns) > StepThreshold_ns) {
+                        historyCount = 0;
+                    }
+                }
+
+                if (historyCount == HistorySize) {
+                    memmove(history, history + 1, (HistorySize - 1) * sizeof(Sample));
+                    historyCount--;
+                }
+                history[historyCount++] = best;
+
+                publishPage(page, fitHistory(history, historyCount));
+
+            }
+
+            if (verbose) {
+                printf(
+                    "offset %+.3f ms, rtt %.3f ms\n",
+                    (best.server_ns - best.local_ns) / 1e6,
+                    best.rtt_ns / 1e6
+                );
+                fflush(stdout);
+            }
+
+        } else if (verbose) {
+
+            printf("no usable sample\n");
+            fflush(stdout);
+
+        }
+
+        // a second at a time, to keep the heartbeat going
+        for (int i = 0; i < interval_s && running; i++) {
+            sleep(1);
+            heartbeat(page);
+        }
+
+    }
+
+    if (shm) {
+        shmdt(shm);
+    }
+
+    // readers still mapping the page see it die at once
+    if (page) {
+        __atomic_store_n(&page->magic, 0, __ATOMIC_RELEASE);
+        munmap(page, sizeof(NodeRedTimePage));
+        shm_unlink(pageName);
+    }
+
+    return 0;
+
+}
@@ -0,0 +1,579 @@
+/*
+ *  Accuracy versus traffic for different synchronisation policies.
+ *
+ *  Runs NodeRedTime's synchronisation logic against a simulated
+ *  Node-Red server and a simulated crystal oscillator for a number of
+ *  simulated weeks, taking a timestamp every SampleInterval_s, and
+ *  reports for each policy:
+ *
+ *  - timestamp error percentiles (p50, p95, p99, max) in milliseconds;
+ *  - the percentage of samples where no timestamp was available;
+ *  - the number of synchronisation attempts; and
+ *  - total radio time in seconds.
+ *
+ *  The policies are:
+ *
+ *  1. Fixed recall (the library's syntheticTime() behaviour) at several
+ *     recall periods.
+ *  2. Adaptive recall: the recall period doubles while the error seen
+ *     at each resynchronisation stays below TargetError_ms and halves
+ *     when it does not.
+ *  3. Drift-corrected: estimates the oscillator's rate error from
+ *     successive synchronisations and corrects for it when
+ *     extrapolating.
+ *  4. Kalman: a two-state (offset, rate) Kalman filter which
+ *     resynchronises when its predicted error exceeds TargetError_ms.
+ *
+ *  The simulated world has a fixed oscillator error, a daily
+ *  temperature swing acting through a typical tuning-fork crystal's
+ *  parabolic temperature coefficient, network jitter (which makes the
+ *  request and reply legs asymmetric) and random server outages. Every
+ *  policy sees the same world (same random seed).
+ *
+ *  No WiFi is needed. Works on ESP8266 and ESP32. Takes a few minutes.
+ *
+ *  Created 2026-10-18. MIT License.
+ */
+
+#include <Arduino.h>
+#include <NodeRedTime.h>
+
+// Simulated world - configure for your situation
+const int    Weeks = 4;                  // at most 7 (millis() wraps after 49.7 days)
+const int    SampleInterval_s = 10;      // how often the sketch wants a timestamp
+const double Drift_ppm = 20.0;           // oscillator error at the turnover temperature
+const double TempMean_C = 22.0;          // average ambient temperature
+const double TempSwing_C = 8.0;          // daily swing (peak to mean)
+const double TempCoefficient = -0.034;   // ppm/°C² (typical 32kHz tuning fork)
+const double Turnover_C = 25.0;          // turnover temperature of the crystal
+const double NetworkBase_ms = 6.0;       // minimum round trip
+const double NetworkJitter_ms = 4.0;     // mean of exponential extra delay per leg
+const double ServerJitter_ms = 0.5;      // Node-Red's own timestamp noise (1σ)
+const double OutagesPerWeek = 2.0;       // mean number of server outages
+const double OutageLength_s = 1800.0;    // mean outage length
+const double RequestOverhead_ms = 20.0;  // radio time for connection setup etc
+const double FailureCost_ms = 200.0;     // radio time spent on a failed attempt
+const double Retry_s = 60.0;             // retry interval after a failure
+const double TargetError_ms = 50.0;      // accuracy target for adaptive and Kalman
+const uint32_t Seed = 12345;
+
+// the epoch time at which the simulation starts (2026-10-14T00:00:00Z)
+const double StartEpoch_ms = 1791936000000.0;
+
+
+/*
+ *  Small reproducible random number generator (xorshift32) plus the
+ *  two distributions needed.
+ */
+struct Random {
+
+    uint32_t state;
+
+    void seed(uint32_t s) { state = s ? s : 1; }
+
+    double uniform() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (state + 0.5) / 4294967296.0;
+    }
+
+    double exponential(double mean) {
+        return -mean * log(uniform());
+    }
+
+    double normal(double sigma) {
+        return sigma * sqrt(-2.0 * log(uniform())) * cos(2.0 * PI * uniform());
+    }
+
+};
+
+
+/*
+ *  The simulated world: true time, the device's millis() clock and the
+ *  Node-Red server.
+ */
+struct World {
+
+    Random random;
+    double true_ms;         // true epoch time
+    double uptime_ms;       // device millis() (not wrapped)
+    double outageStart_ms;  // next or current outage (true time)
+    double outageEnd_ms;
+    double radio_ms;        // total radio time
+    unsigned long attempts; // synchronisation attempts
+
+    void begin() {
+        random.seed(Seed);
+        true_ms = StartEpoch_ms;
+        uptime_ms = 0.0;
+        radio_ms = 0.0;
+        attempts = 0;
+        scheduleOutage(true_ms);
+    }
+
+    void scheduleOutage(double after_ms) {
+        outageStart_ms = after_ms + random.exponential(7 * 86400000.0 / OutagesPerWeek);
+        outageEnd_ms = outageStart_ms + random.exponential(OutageLength_s * 1000.0);
+    }
+
+    // oscillator rate error (parts per million) at the current moment
+    double ppm() {
+        double dayFraction = fmod(true_ms / 86400000.0, 1.0);
+        double temperature = TempMean_C + TempSwing_C * sin(2.0 * PI * dayFraction);
+        double delta = temperature - Turnover_C;
+        return Drift_ppm + TempCoefficient * delta * delta;
+    }
+
+    void advance(double dt_ms) {
+        uptime_ms += dt_ms * (1.0 + ppm() * 1E-6);
+        true_ms += dt_ms;
+        if (true_ms > outageEnd_ms) scheduleOutage(true_ms);
+    }
+
+    /*
+     *  One request to the server. On success, returns the server's reply
+     *  and the millis() values at which the request left and the reply
+     *  arrived. The simulation does not advance during a request (a few
+     *  milliseconds against a SampleInterval_s step).
+     */
+    bool request(double * server_ms, double * sent_ms, double * received_ms) {
+
+        attempts++;
+
+        if (true_ms >= outageStart_ms && true_ms < outageEnd_ms) {
+            radio_ms += FailureCost_ms;
+            return false;
+        }
+
+        double up_ms = NetworkBase_ms / 2.0 + random.exponential(NetworkJitter_ms);
+        double down_ms = NetworkBase_ms / 2.0 + random.exponential(NetworkJitter_ms);
+
+        *sent_ms = uptime_ms;
+        *server_ms = floor(true_ms + up_ms + random.normal(ServerJitter_ms));
+        *received_ms = uptime_ms + up_ms + down_ms;
+
+        radio_ms += RequestOverhead_ms + up_ms + down_ms;
+        return true;
+
+    }
+
+};
+
+
+/*
+ *  Error histogram with logarithmic bins (20 per decade from 0.01ms),
+ *  so percentiles can be estimated without storing every sample.
+ */
+struct Histogram {
+
+    static const int Bins = 160;
+    unsigned long count[Bins];
+    unsigned long samples;
+    unsigned long missing;
+    double worst_ms;
+
+    void begin() {
+        memset(count, 0, sizeof(count));
+        samples = missing = 0;
+        worst_ms = 0.0;
+    }
+
+    void add(double error_ms) {
+        error_ms = fabs(error_ms);
+        int bin = error_ms > 0.01 ? (int)(20.0 * log10(error_ms / 0.01)) : 0;
+        count[constrain(bin, 0, Bins - 1)]++;
+        samples++;
+        worst_ms = max(worst_ms, error_ms);
+    }
+
+    double percentile(double p) {
+        unsigned long target = ceil(p * samples);
+        unsigned long seen = 0;
+        for (int bin = 0; bin < Bins; bin++) {
+            seen += count[bin];
+            if (seen >= target && seen > 0) {
+                // upper edge of the bin
+                return 0.01 * pow(10.0, (bin + 1) / 20.0);
+            }
+        }
+        return worst_ms;
+    }
+
+};
+
+
+/*
+ *  Base for all policies. A NodeRedTime whose network transaction is
+ *  replaced by World::request(), but which otherwise uses the library's
+ *  own synchronisation bookkeeping (acceptSample(), withinRecall()
+ *  and uptimeToEpoch_ms()). The URL is never contacted.
+ */
+class Policy : public NodeRedTime {
+
+    public:
+
+        Policy(const char * name, unsigned int recall_s) :
+            NodeRedTime("http://localhost/time/", recall_s),
+            _name(name) { }
+
+        const char * name() { return _name; }
+
+        virtual void begin() {
+            _epochLastSync_ms = 0.0;
+            _uptimeLastSync_ms = 0.0;
+            _retry_ms = 0.0;
+        }
+
+        // a timestamp for the current moment, if one can be had
+        virtual bool timestamp(World & world, double * epoch_ms) = 0;
+
+    protected:
+
+        const char * _name;
+        double _retry_ms;
+
+        // the round trip of the last ask(), for accept()
+        double _sent_ms = 0.0;
+        double _received_ms = 0.0;
+
+        bool synchronised() {
+            return _epochLastSync_ms >= _minEpoch_ms;
+        }
+
+        /*
+         *  The simulated equivalent of serverTime(). Returns the server's
+         *  reply and the mid-point of the round trip without accepting
+         *  them, so a policy can compare them with its own prediction
+         *  first.
+         */
+        bool ask(World & world, double * server_ms, double * sync_ms) {
+            _sent_ms = _received_ms = world.uptime_ms;
+            if (!world.request(server_ms, &_sent_ms, &_received_ms)) {
+                _retry_ms = world.uptime_ms + Retry_s * 1000.0;
+                return false;
+            }
+            *sync_ms = (_sent_ms + _received_ms) / 2.0;
+            return true;
+        }
+
+        // the round trip of the last ask() sets the error bound, as in a real sync
+        void accept(double server_ms) {
+            time_t epoch;
+            acceptSample(server_ms, _sent_ms, _received_ms, &epoch);
+        }
+
+        bool mayRetry(World & world) {
+            return world.uptime_ms >= _retry_ms;
+        }
+
+};
+
+
+/*
+ *  Exactly what syntheticTime() does: extrapolate within the recall
+ *  period, otherwise ask the server. A failure invalidates the
+ *  synchronisation point so there is no timestamp until the server
+ *  answers again.
+ */
+class FixedRecall : public Policy {
+
+    public:
+
+        FixedRecall(const char * name, unsigned int recall_s) :
+            Policy(name, recall_s) { }
+
+        bool timestamp(World & world, double * epoch_ms) override {
+
+            if (!(synchronised() && withinRecall(world.uptime_ms))) {
+
+                double server_ms = 0.0, sync_ms = world.uptime_ms;
+                if (!ask(world, &server_ms, &sync_ms)) server_ms = 0.0;
+                accept(server_ms);
+
+                if (!synchronised()) return false;
+
+            }
+
+            *epoch_ms = uptimeToEpoch_ms(world.uptime_ms);
+            return true;
+
+        }
+
+};
+
+
+/*
+ *  Recall period adapts to the error observed at each resynchronisation.
+ *  Keeps extrapolating through failures.
+ */
+class AdaptiveRecall : public Policy {
+
+    public:
+
+        AdaptiveRecall() : Policy("adaptive", 900) { }
+
+        bool timestamp(World & world, double * epoch_ms) override {
+
+            bool due = !synchronised() || !withinRecall(world.uptime_ms);
+
+            if (due && mayRetry(world)) {
+
+                double server_ms, sync_ms;
+                if (ask(world, &server_ms, &sync_ms)) {
+
+                    if (synchronised()) {
+                        double error_ms = fabs(uptimeToEpoch_ms(sync_ms) - server_ms);
+                        if (error_ms < TargetError_ms / 2.0) _recall_ms *= 2.0;
+                        if (error_ms > TargetError_ms) _recall_ms /= 2.0;
+                        _recall_ms = constrain(_recall_ms, 60000.0, 14400000.0);
+                    }
+
+                    accept(server_ms);
+
+                }
+
+            }
+
+            if (!synchronised()) return false;
+
+            *epoch_ms = uptimeToEpoch_ms(world.uptime_ms);
+            return true;
+
+        }
+
+};
+
+
+/*
+ *  Learns the oscillator's rate from successive synchronisations and
+ *  applies it when extrapolating. Keeps extrapolating through failures.
+ */
+class DriftCorrected : public Policy {
+
+    public:
+
+        DriftCorrected() : Policy("drift-corrected", 14400) { }
+
+        void begin() override {
+            Policy::begin();
+            _rate = 1.0;
+            _haveRate = false;
+        }
+
+        bool timestamp(World & world, double * epoch_ms) override {
+
+            bool due = !synchronised() || !withinRecall(world.uptime_ms);
+
+            if (due && mayRetry(world)) {
+
+                double server_ms, sync_ms;
+                if (ask(world, &server_ms, &sync_ms)) {
+
+                    if (synchronised()) {
+                        double rate =
+                            (server_ms - _epochLastSync_ms) /
+                            (sync_ms - _uptimeLastSync_ms);
+                        _rate = _haveRate ? 0.5 * _rate + 0.5 * rate : rate;
+                        _haveRate = true;
+                    }
+
+                    accept(server_ms);
+
+                }
+
+            }
+
+            if (!synchronised()) return false;
+
+            *epoch_ms = _epochLastSync_ms + (world.uptime_ms - _uptimeLastSync_ms) * _rate;
+            return true;
+
+        }
+
+    protected:
+
+        double _rate;
+        bool _haveRate;
+
+};
+
+
+/*
+ *  Two-state Kalman filter on offset (server minus uptime, ms) and rate
+ *  error (ms per ms). Resynchronises when the predicted offset error
+ *  (1σ) exceeds half of TargetError_ms, bounded by the library's recall
+ *  limits. Keeps extrapolating through failures.
+ */
+class Kalman : public Policy {
+
+    public:
+
+        Kalman() : Policy("kalman", 14400) { }
+
+        void begin() override {
+            Policy::begin();
+            _offset = _skew = 0.0;
+            _p00 = 1E6; _p01 = 0.0; _p11 = 1E-8;
+            _t_ms = 0.0;
+            _updates = 0;
+        }
+
+        bool timestamp(World & world, double * epoch_ms) override {
+
+            double age_ms = world.uptime_ms - _t_ms;
+
+            bool due =
+                _updates == 0 ||
+                (
+                    age_ms >= 60000.0 &&
+                    (
+                        variance(world.uptime_ms) > sq(TargetError_ms / 2.0) ||
+                        age_ms >= 14400000.0
+                    )
+                );
+
+            if (due && mayRetry(world)) {
+
+                double server_ms, sync_ms;
+                if (ask(world, &server_ms, &sync_ms)) {
+                    update(server_ms - sync_ms, sync_ms);
+                    accept(server_ms);
+                }
+
+            }
+
+            if (_updates == 0) return false;
+
+            *epoch_ms = world.uptime_ms + _offset + _skew * (world.uptime_ms - _t_ms);
+            return true;
+
+        }
+
+    protected:
+
+        double _offset, _skew;      // state at _t_ms
+        double _p00, _p01, _p11;    // covariance
+        double _t_ms;
+        unsigned long _updates;
+
+        // process noise: rate wander (per ms) and measurement noise (ms²)
+        static constexpr double RateNoise = 1E-17;
+        static constexpr double MeasurementNoise = 9.0;
+
+        double variance(double now_ms) {
+            double dt = now_ms - _t_ms;
+            return _p00 + 2.0 * dt * _p01 + dt * dt * _p11 + RateNoise * dt * dt * dt / 3.0;
+        }
+
+        void update(double z, double now_ms) {
+
+            if (_updates++ == 0) {
+                _offset = z;
+                _p00 = MeasurementNoise;
+                _t_ms = now_ms;
+                return;
+            }
+
+            // predict
+            double dt = now_ms - _t_ms;
+            _offset += _skew * dt;
+            _p00 = variance(now_ms);
+            _p01 += dt * _p11 + RateNoise * dt * dt / 2.0;
+            _p11 += RateNoise * dt;
+            _t_ms = now_ms;
+
+            // correct
+            double s = _p00 + MeasurementNoise;
+            double k0 = _p00 / s, k1 = _p01 / s;
+            double innovation = z - _offset;
+            _offset += k0 * innovation;
+            _skew += k1 * innovation;
+            _p11 -= k1 * _p01;
+            _p01 -= k1 * _p00;
+            _p00 -= k0 * _p00;
+
+        }
+
+};
+
+
+FixedRecall fixed15m("fixed 15 min", 900);
+FixedRecall fixed1h("fixed 1 hour", 3600);
+FixedRecall fixed4h("fixed 4 hours", 14400);
+AdaptiveRecall adaptive;
+DriftCorrected driftCorrected;
+Kalman kalman;
+
+Policy * const Policies[] = {
+    &fixed15m, &fixed1h, &fixed4h, &adaptive, &driftCorrected, &kalman
+};
+
+
+void runPolicy(Policy * policy) {
+
+    World world;
+    Histogram errors;
+
+    world.begin();
+    errors.begin();
+    policy->begin();
+
+    const unsigned long steps = Weeks * 7UL * 86400UL / SampleInterval_s;
+
+    for (unsigned long step = 0; step < steps; step++) {
+
+        world.advance(SampleInterval_s * 1000.0);
+
+        double estimate_ms;
+        if (policy->timestamp(world, &estimate_ms)) {
+            errors.add(estimate_ms - world.true_ms);
+        } else {
+            errors.missing++;
+        }
+
+        if (step % 1000 == 0) yield();
+
+    }
+
+    Serial.printf(
+        "%-16s %9.1f %9.1f %9.1f %9.1f %8.2f %9lu %9.1f\n",
+        policy->name(),
+        errors.percentile(0.50),
+        errors.percentile(0.95),
+        errors.percentile(0.99),
+        errors.worst_ms,
+        100.0 * errors.missing / steps,
+        world.attempts,
+        world.radio_ms / 1000.0
+    );
+
+}
+
+
+void setup() {
+
+    Serial.begin(74880); while (!Serial); Serial.println();
+
+    Serial.printf(
+        "%d simulated weeks, drift %.1f ppm, swing %.1f°C, %.1f outages/week\n\n",
+        Weeks, Drift_ppm, TempSwing_C, OutagesPerWeek
+    );
+
+    Serial.printf(
+        "%-16s %9s %9s %9s %9s %8s %9s %9s\n",
+        "Policy", "p50 ms", "p95 ms", "p99 ms", "max ms", "miss %", "syncs", "radio s"
+    );
+
+    for (Policy * policy : Policies) {
+        runPolicy(policy);
+    }
+
+}
+
+
+void loop() {
+
+    delay(1000);
+
+}
@@ -0,0 +1,150 @@
+//
+//  Australia_Sydney.h
+//
+//  Generated by generate_zone_table.py: Australia/Sydney 1970..2037
+//
+
+#pragma once
+
+#include <NodeRedTimeZoneTable.h>
+
+const NodeRedTimeZoneTable::Transition Australia_Sydney[] PROGMEM = {
+	{ INT32_MIN, 600, 0, 0 },	// before 1970
+	{ 961440, 660, 1, 0 },	// 1971-10-30 16:00 UTC
+	{ 1132800, 600, 0, 0 },	// 1972-02-26 16:00 UTC
+	{ 1485600, 660, 1, 0 },	// 1972-10-28 16:00 UTC
+	{ 1667040, 600, 0, 0 },	// 1973-03-03 16:00 UTC
+	{ 2009760, 660, 1, 0 },	// 1973-10-27 16:00 UTC
+	{ 2191200, 600, 0, 0 },	// 1974-03-02 16:00 UTC
+	{ 2533920, 660, 1, 0 },	// 1974-10-26 16:00 UTC
+	{ 2715360, 600, 0, 0 },	// 1975-03-01 16:00 UTC
+	{ 3058080, 660, 1, 0 },	// 1975-10-25 16:00 UTC
+	{ 3249600, 600, 0, 0 },	// 1976-03-06 16:00 UTC
+	{ 3592320, 660, 1, 0 },	// 1976-10-30 16:00 UTC
+	{ 3773760, 600, 0, 0 },	// 1977-03-05 16:00 UTC
+	{ 4116480, 660, 1, 0 },	// 1977-10-29 16:00 UTC
+	{ 4297920, 600, 0, 0 },	// 1978-03-04 16:00 UTC
+	{ 4640640, 660, 1, 0 },	// 1978-10-28 16:00 UTC
+	{ 4822080, 600, 0, 0 },	// 1979-03-03 16:00 UTC
+	{ 5164800, 660, 1, 0 },	// 1979-10-27 16:00 UTC
+	{ 5346240, 600, 0, 0 },	// 1980-03-01 16:00 UTC
+	{ 5688960, 660, 1, 0 },	// 1980-10-25 16:00 UTC
+	{ 5870400, 600, 0, 0 },	// 1981-02-28 16:00 UTC
+	{ 6213120, 660, 1, 0 },	// 1981-10-24 16:00 UTC
+	{ 6444960, 600, 0, 0 },	// 1982-04-03 16:00 UTC
+	{ 6747360, 660, 1, 0 },	// 1982-10-30 16:00 UTC
+	{ 6928800, 600, 0, 0 },	// 1983-03-05 16:00 UTC
+	{ 7271520, 660, 1, 0 },	// 1983-10-29 16:00 UTC
+	{ 7452960, 600, 0, 0 },	// 1984-03-03 16:00 UTC
+	{ 7795680, 660, 1, 0 },	// 1984-10-27 16:00 UTC
+	{ 7977120, 600, 0, 0 },	// 1985-03-02 16:00 UTC
+	{ 8319840, 660, 1, 0 },	// 1985-10-26 16:00 UTC
+	{ 8521440, 600, 0, 0 },	// 1986-03-15 16:00 UTC
+	{ 8833920, 660, 1, 0 },	// 1986-10-18 16:00 UTC
+	{ 9045600, 600, 0, 0 },	// 1987-03-14 16:00 UTC
+	{ 9368160, 660, 1, 0 },	// 1987-10-24 16:00 UTC
+	{ 9579840, 600, 0, 0 },	// 1988-03-19 16:00 UTC
+	{ 9902400, 660, 1, 0 },	// 1988-10-29 16:00 UTC
+	{ 10104000, 600, 0, 0 },	// 1989-03-18 16:00 UTC
+	{ 10426560, 660, 1, 0 },	// 1989-10-28 16:00 UTC
+	{ 10608000, 600, 0, 0 },	// 1990-03-03 16:00 UTC
+	{ 10950720, 660, 1, 0 },	// 1990-10-27 16:00 UTC
+	{ 11132160, 600, 0, 0 },	// 1991-03-02 16:00 UTC
+	{ 11474880, 660, 1, 0 },	// 1991-10-26 16:00 UTC
+	{ 11656320, 600, 0, 0 },	// 1992-02-29 16:00 UTC
+	{ 11999040, 660, 1, 0 },	// 1992-10-24 16:00 UTC
+	{ 12190560, 600, 0, 0 },	// 1993-03-06 16:00 UTC
+	{ 12533280, 660, 1, 0 },	// 1993-10-30 16:00 UTC
+	{ 12714720, 600, 0, 0 },	// 1994-03-05 16:00 UTC
+	{ 13057440, 660, 1, 0 },	// 1994-10-29 16:00 UTC
+	{ 13238880, 600, 0, 0 },	// 1995-03-04 16:00 UTC
+	{ 13581600, 660, 1, 0 },	// 1995-10-28 16:00 UTC
+	{ 13803360, 600, 0, 0 },	// 1996-03-30 16:00 UTC
+	{ 14105760, 660, 1, 0 },	// 1996-10-26 16:00 UTC
+	{ 14327520, 600, 0, 0 },	// 1997-03-29 16:00 UTC
+	{ 14629920, 660, 1, 0 },	// 1997-10-25 16:00 UTC
+	{ 14851680, 600, 0, 0 },	// 1998-03-28 16:00 UTC
+	{ 15154080, 660, 1, 0 },	// 1998-10-24 16:00 UTC
+	{ 15375840, 600, 0, 0 },	// 1999-03-27 16:00 UTC
+	{ 15688320, 660, 1, 0 },	// 1999-10-30 16:00 UTC
+	{ 15900000, 600, 0, 0 },	// 2000-03-25 16:00 UTC
+	{ 16121760, 660, 1, 0 },	// 2000-08-26 16:00 UTC
+	{ 16424160, 600, 0, 0 },	// 2001-03-24 16:00 UTC
+	{ 16736640, 660, 1, 0 },	// 2001-10-27 16:00 UTC
+	{ 16958400, 600, 0, 0 },	// 2002-03-30 16:00 UTC
+	{ 17260800, 660, 1, 0 },	// 2002-10-26 16:00 UTC
+	{ 17482560, 600, 0, 0 },	// 2003-03-29 16:00 UTC
+	{ 17784960, 660, 1, 0 },	// 2003-10-25 16:00 UTC
+	{ 18006720, 600, 0, 0 },	// 2004-03-27 16:00 UTC
+	{ 18319200, 660, 1, 0 },	// 2004-10-30 16:00 UTC
+	{ 18530880, 600, 0, 0 },	// 2005-03-26 16:00 UTC
+	{ 18843360, 660, 1, 0 },	// 2005-10-29 16:00 UTC
+	{ 19065120, 600, 0, 0 },	// 2006-04-01 16:00 UTC
+	{ 19367520, 660, 1, 0 },	// 2006-10-28 16:00 UTC
+	{ 19579200, 600, 0, 0 },	// 2007-03-24 16:00 UTC
+	{ 19891680, 660, 1, 0 },	// 2007-10-27 16:00 UTC
+	{ 20123520, 600, 0, 0 },	// 2008-04-05 16:00 UTC
+	{ 20385600, 660, 1, 0 },	// 2008-10-04 16:00 UTC
+	{ 20647680, 600, 0, 0 },	// 2009-04-04 16:00 UTC
+	{ 20909760, 660, 1, 0 },	// 2009-10-03 16:00 UTC
+	{ 21171840, 600, 0, 0 },	// 2010-04-03 16:00 UTC
+	{ 21433920, 660, 1, 0 },	// 2010-10-02 16:00 UTC
+	{ 21696000, 600, 0, 0 },	// 2011-04-02 16:00 UTC
+	{ 21958080, 660, 1, 0 },	// 2011-10-01 16:00 UTC
+	{ 22220160, 600, 0, 0 },	// 2012-03-31 16:00 UTC
+	{ 22492320, 660, 1, 0 },	// 2012-10-06 16:00 UTC
+	{ 22754400, 600, 0, 0 },	// 2013-04-06 16:00 UTC
+	{ 23016480, 660, 1, 0 },	// 2013-10-05 16:00 UTC
+	{ 23278560, 600, 0, 0 },	// 2014-04-05 16:00 UTC
+	{ 23540640, 660, 1, 0 },	// 2014-10-04 16:00 UTC
+	{ 23802720, 600, 0, 0 },	// 2015-04-04 16:00 UTC
+	{ 24064800, 660, 1, 0 },	// 2015-10-03 16:00 UTC
+	{ 24326880, 600, 0, 0 },	// 2016-04-02 16:00 UTC
+	{ 24588960, 660, 1, 0 },	// 2016-10-01 16:00 UTC
+	{ 24851040, 600, 0, 0 },	// 2017-04-01 16:00 UTC
+	{ 25113120, 660, 1, 0 },	// 2017-09-30 16:00 UTC
+	{ 25375200, 600, 0, 0 },	// 2018-03-31 16:00 UTC
+	{ 25647360, 660, 1, 0 },	// 2018-10-06 16:00 UTC
+	{ 25909440, 600, 0, 0 },	// 2019-04-06 16:00 UTC
+	{ 26171520, 660, 1, 0 },	// 2019-10-05 16:00 UTC
+	{ 26433600, 600, 0, 0 },	// 2020-04-04 16:00 UTC
+	{ 26695680, 660, 1, 0 },	// 2020-10-03 16:00 UTC
+	{ 26957760, 600, 0, 0 },	// 2021-04-03 16:00 UTC
+	{ 27219840, 660, 1, 0 },	// 2021-10-02 16:00 UTC
+	{ 27481920, 600, 0, 0 },	// 2022-04-02 16:00 UTC
+	{ 27744000, 660, 1, 0 },	// 2022-10-01 16:00 UTC
+	{ 28006080, 600, 0, 0 },	// 2023-04-01 16:00 UTC
+	{ 28268160, 660, 1, 0 },	// 2023-09-30 16:00 UTC
+	{ 28540320, 600, 0, 0 },	// 2024-04-06 16:00 UTC
+	{ 28802400, 660, 1, 0 },	// 2024-10-05 16:00 UTC
+	{ 29064480, 600, 0, 0 },	// 2025-04-05 16:00 UTC
+	{ 29326560, 660, 1, 0 },	// 2025-10-04 16:00 UTC
+	{ 29588640, 600, 0, 0 },	// 2026-04-04 16:00 UTC
+	{ 29850720, 660, 1, 0 },	// 2026-10-03 16:00 UTC
+	{ 30112800, 600, 0, 0 },	// 2027-04-03 16:00 UTC
+	{ 30374880, 660, 1, 0 },	// 2027-10-02 16:00 UTC
+	{ 30636960, 600, 0, 0 },	// 2028-04-01 16:00 UTC
+	{ 30899040, 660, 1, 0 },	// 2028-09-30 16:00 UTC
+	{ 31161120, 600, 0, 0 },	// 2029-03-31 16:00 UTC
+	{ 31433280, 660, 1, 0 },	// 2029-10-06 16:00 UTC
+	{ 31695360, 600, 0, 0 },	// 2030-04-06 16:00 UTC
+	{ 31957440, 660, 1, 0 },	// 2030-10-05 16:00 UTC
+	{ 32219520, 600, 0, 0 },	// 2031-04-05 16:00 UTC
+	{ 32481600, 660, 1, 0 },	// 2031-10-04 16:00 UTC
+	{ 32743680, 600, 0, 0 },	// 2032-04-03 16:00 UTC
+	{ 33005760, 660, 1, 0 },	// 2032-10-02 16:00 UTC
+	{ 33267840, 600, 0, 0 },	// 2033-04-02 16:00 UTC
+	{ 33529920, 660, 1, 0 },	// 2033-10-01 16:00 UTC
+	{ 33792000, 600, 0, 0 },	// 2034-04-01 16:00 UTC
+	{ 34054080, 660, 1, 0 },	// 2034-09-30 16:00 UTC
+	{ 34316160, 600, 0, 0 },	// 2035-03-31 16:00 UTC
+	{ 34588320, 660, 1, 0 },	// 2035-10-06 16:00 UTC
+	{ 34850400, 600, 0, 0 },	// 2036-04-05 16:00 UTC
+	{ 35112480, 660, 1, 0 },	// 2036-10-04 16:00 UTC
+	{ 35374560, 600, 0, 0 },	// 2037-04-04 16:00 UTC
+	{ 35636640, 660, 1, 0 },	// 2037-10-03 16:00 UTC
+};
+
+const size_t Australia_Sydney_Count = sizeof(Australia_Sydney) / sizeof(Australia_Sydney[0]);
+
+const char Australia_Sydney_POSIX[] = "AEST-10AEDT,M10.1.0,M4.1.0/3";
@@ -0,0 +1,144 @@
+/*
+ *  Local time from a generated transition table.
+ *
+ *  Australia_Sydney.h was produced by:
+ *
+ *      python3 generate_zone_table.py Australia/Sydney 1970 2037
+ *
+ *  Substitute your own zone and re-run the generator. The sketch:
+ *
+ *  1. Prints some historical Sydney times which a POSIX TZ string
+ *     gets wrong (the rules have changed several times since 1970).
+ *  2. Times table lookups against localtime_r().
+ *  3. Prints the current local time every ten seconds, using
+ *     NodeRedTime for synthetic time and the table for conversion.
+ *
+ *  Created 2026-10-18. MIT License.
+ */
+
+#include <Arduino.h>
+#if (ESP8266)
+#include <ESP8266WiFi.h>
+#elif (ESP32)
+#include <WiFi.h>
+#endif
+#include <NodeRedTime.h>
+#include <NodeRedTimeZoneTable.h>
+#include "Australia_Sydney.h"
+
+// Configure for your situation
+const char * WiFi_SSID = "REPLACE ME";
+const char * WiFi_PSK  = "REPLACE ME";
+NodeRedTime nodeRedTime("http://MYHOST.MYDOMAIN.com:1880/time/");
+
+NodeRedTimeZoneTable sydney(Australia_Sydney, Australia_Sydney_Count);
+
+const int Iterations = 10000;
+
+
+void printTime(time_t epoch, const tm & timeinfo, const char * tag) {
+    Serial.printf(
+        "  %10lld  %04d-%02d-%02d %02d:%02d:%02d %s  (%s)\n",
+        (long long)epoch,
+        timeinfo.tm_year + 1900,
+        timeinfo.tm_mon + 1,
+        timeinfo.tm_mday,
+        timeinfo.tm_hour,
+        timeinfo.tm_min,
+        timeinfo.tm_sec,
+        timeinfo.tm_isdst ? "DST" : "STD",
+        tag
+    );
+}
+
+
+void history() {
+
+    // instants where the 1970s-2000s rules differ from today's
+    const time_t Instants[] = {
+        87955200,       // 1972-10-15 (DST began late in October)
+        700617600,      // 1992-03-15 (DST ended on March 1)
+        967766400,      // 2000-09-01 (Olympic Games - DST began in August)
+        1175212800      // 2007-03-30 (DST ended in March)
+    };
+
+    Serial.printf("Historical conversions: table versus POSIX TZ string\n");
+
+    setenv("TZ", Australia_Sydney_POSIX, 1);
+    tzset();
+
+    for (time_t epoch : Instants) {
+
+        tm timeinfo;
+
+        sydney.localTime(epoch, &timeinfo);
+        printTime(epoch, timeinfo, "table");
+
+        localtime_r(&epoch, &timeinfo);
+        printTime(epoch, timeinfo, "POSIX");
+
+    }
+
+}
+
+
+void benchmark() {
+
+    tm timeinfo;
+    time_t epoch = 1790000000;
+
+    unsigned long start = micros();
+    for (int i = 0; i < Iterations; i++) {
+        sydney.localTime(epoch + i * 60, &timeinfo);
+    }
+    unsigned long table_us = micros() - start;
+
+    start = micros();
+    for (int i = 0; i < Iterations; i++) {
+        time_t t = epoch + i * 60;
+        localtime_r(&t, &timeinfo);
+    }
+    unsigned long libc_us = micros() - start;
+
+    Serial.printf(
+        "Conversion cost: table %.2f us, localtime_r() %.2f us\n",
+        (double)table_us / Iterations,
+        (double)libc_us / Iterations
+    );
+
+}
+
+
+void setup() {
+
+    Serial.begin(74880);
+    while (!Serial);
+    Serial.println();
+
+    history();
+    benchmark();
+
+    WiFi.mode(WIFI_STA);
+    WiFi.begin(WiFi_SSID, WiFi_PSK);
+    while (WiFi.status() != WL_CONNECTED) {
+        delay(500);
+    }
+
+}
+
+
+void loop() {
+
+    time_t epoch;
+
+    if (nodeRedTime.syntheticTime(&epoch)) {
+
+        tm timeinfo;
+        sydney.localTime(epoch, &timeinfo);
+        printTime(epoch, timeinfo, "now");
+
+    }
+
+    delay(10000);
+
+}
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+#
+#  Generate a NodeRedTimeZoneTable transition table from the IANA tz
+#  database.
+#
+#  Usage:
+#
+#    python3 generate_zone_table.py Australia/Sydney [first_year [last_year]]
+#
+#  writes Australia_Sydney.h (in the current directory) containing:
+#
+#  - Australia_Sydney[], a PROGMEM array of NodeRedTimeZoneTable::Transition;
+#  - Australia_Sydney_Count, the number of entries; and
+#  - Australia_Sydney_POSIX, the zone's current POSIX TZ string (for
+#    NodeRedTimeZone or setenv("TZ") past the end of the table).
+#
+#  The year range defaults to 1970..2037. The first entry gives the offset
+#  in force at the start of first_year, the remainder every change of UTC
+#  offset or daylight-saving flag up to the end of last_year.
+#
+#  Uses the standard library's zoneinfo module (Python 3.9+), which reads
+#  the system tz database or the "tzdata" package. Offsets are stored in
+#  whole minutes, so local mean time offsets (only relevant before about
+#  1900) are rounded to the nearest minute.
+#
+#  Created 2026-10-18. MIT License.
+#
+
+import os
+import re
+import sys
+from datetime import datetime, timedelta, timezone
+from zoneinfo import ZoneInfo, TZPATH
+
+# coarse scan step - no zone changes offset twice within this interval
+STEP = timedelta(hours=6)
+
+INT32_MIN = -2**31
+
+
+def state(zone, instant):
+    local = instant.astimezone(zone)
+    offset = local.utcoffset()
+    dst = local.dst()
+    return (round(offset.total_seconds() / 60), 1 if dst else 0)
+
+
+def transitions(zone, first_year, last_year):
+    # scan in STEP increments, then bisect each change to the second
+    start = datetime(first_year, 1, 1, tzinfo=timezone.utc)
+    end = datetime(last_year + 1, 1, 1, tzinfo=timezone.utc)
+
+    result = [(INT32_MIN, *state(zone, start))]
+
+    t = start
+    previous = state(zone, t)
+    while t < end:
+        u = min(t + STEP, end)
+        current = state(zone, u)
+        if current != previous:
+            low, high = t, u
+            while high - low > timedelta(seconds=1):
+                mid = low + (high - low) / 2
+                if state(zone, mid) == previous:
+                    low = mid
+                else:
+                    high = mid
+            at = int(high.timestamp())
+            if at % 60:
+                sys.exit("transition at %s is not on a whole minute" % high)
+            result.append((at // 60, *current))
+            previous = current
+        t = u
+
+    return result
+
+
+def posix_string(name):
+    # the POSIX TZ string is the last line of a version 2+ TZif file
+    paths = list(TZPATH)
+    try:
+        import tzdata
+        paths.append(os.path.join(os.path.dirname(tzdata.__file__), "zoneinfo"))
+    except ImportError:
+        pass
+    for path in paths:
+        file = os.path.join(path, name)
+        if os.path.isfile(file):
+            with open(file, "rb") as f:
+                data = f.read()
+            if data[:4] == b"TZif" and data[4:5] >= b"2":
+                return data.rstrip(b"\n").rsplit(b"\n", 1)[-1].decode("ascii")
+    return ""
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit("usage: %s Area/Location [first_year [last_year]]" % sys.argv[0])
+
+    name = sys.argv[1]
+    first_year = int(sys.argv[2]) if len(sys.argv) > 2 else 1970
+    last_year = int(sys.argv[3]) if len(sys.argv) > 3 else 2037
+
+    zone = ZoneInfo(name)
+    table = transitions(zone, first_year, last_year)
+    posix = posix_string(name)
+
+    ident = re.sub(r"[^A-Za-z0-9]", "_", name)
+
+    lines = []
+    lines.append("//")
+    lines.append("//  %s.h" % ident)
+    lines.append("//")
+    lines.append("//  Generated by generate_zone_table.py: %s %d..%d" % (name, first_year, last_year))
+    lines.append("//")
+    lines.append("")
+    lines.append("#pragma once")
+    lines.append("")
+    lines.append("#include <NodeRedTimeZoneTable.h>")
+    lines.append("")
+    lines.append("const NodeRedTimeZoneTable::Transition %s[] PROGMEM = {" % ident)
+    for at, offset, dst in table:
+        if at == INT32_MIN:
+            when = "before %d" % first_year
+            at_text = "INT32_MIN"
+        else:
+            when = datetime.fromtimestamp(at * 60, timezone.utc).strftime("%Y-%m-%d %H:%M UTC")
+            at_text = str(at)
+        lines.append("\t{ %s, %d, %d, 0 },\t// %s" % (at_text, offset, dst, when))
+    lines.append("};")
+    lines.append("")
+    lines.append("const size_t %s_Count = sizeof(%s) / sizeof(%s[0]);" % (ident, ident, ident))
+    lines.append("")
+    lines.append("const char %s_POSIX[] = \"%s\";" % (ident, posix))
+    lines.append("")
+
+    with open(ident + ".h", "w") as f:
+        f.write("\n".join(lines))
+
+    print("%s.h: %d entries, %d bytes" % (ident, len(table), 8 * len(table)))
+
+
+if __name__ == "__main__":
+    main()
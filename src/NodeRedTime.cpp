@@ -6,6 +6,27 @@
 
 #include "NodeRedTime.h"
 
+#include <sys/time.h>
+
+#if (ESP32)
+#include <WiFi.h>
+#include <esp_sntp.h>
+#endif
+
+#if (ESP8266)
+#include <ESP8266WiFi.h>
+#include <coredecls.h>
+#endif
+
+/*
+ *	The last SNTP synchronisation. SNTP sets the one system clock,
+ *	so this is shared by every NodeRedTime object. On ESP32 it is
+ *	written from the lwIP task; each is a single 32-bit store.
+ */
+static volatile bool sntpValid = false;
+static volatile unsigned long sntpSync_ms = 0;
+static volatile unsigned long sntpSyncCount = 0;
+
 NodeRedTime::NodeRedTime(
 	const char * url,
 	const unsigned int recall_s,
@@ -13,7 +34,7 @@ NodeRedTime::NodeRedTime(
 ) {
 
 	// remember the URL
-	_url = String(url);
+	setServer(url);
 
     /*
 	 *	minEpoch_s is the earliest moment in time which serverTime()
@@ -32,57 +53,177 @@ NodeRedTime::NodeRedTime(
 }
 
 
+void NodeRedTime::setServer(const char * url) {
+
+	// abandon anything in progress (or opened by prepare()) with the old server
+	if (_syncStatus == SYNC_PENDING || _client->connected()) {
+		_client->stop();
+	}
+	_syncStatus = SYNC_IDLE;
+
+	_url = String(url);
+
+	/*
+	 *	split the URL into the parts beginSync() needs:
+	 *		http[s]://host[:port][/path]
+	 *		coap://host[:port][/path]
+	 *	A missing port defaults to 80 (443 for https, 5683 for
+	 *	coap) and a missing path to "/".
+	 */
+	String authority = _url;
+	int scheme = authority.indexOf("://");
+	_secure = false;
+	_coap = false;
+	if (scheme >= 0) {
+		_secure = authority.substring(0, scheme).equalsIgnoreCase("https");
+		_coap = authority.substring(0, scheme).equalsIgnoreCase("coap");
+		authority = authority.substring(scheme + 3);
+	}
+	_port = _secure ? 443 : (_coap ? 5683 : 80);
+	_client = _secure ? (WiFiClient *)&_secureClient : &_plainClient;
+	int slash = authority.indexOf('/');
+	if (slash >= 0) {
+		_path = authority.substring(slash);
+		authority = authority.substring(0, slash);
+	} else {
+		_path = "/";
+	}
+	int colon = authority.indexOf(':');
+	if (colon >= 0) {
+		_port = authority.substring(colon + 1).toInt();
+		authority = authority.substring(0, colon);
+	}
+	_host = authority;
+
+	// nothing learned about the old server applies to the new one
+	_serverIPValid = false;
+	_srtt_ms = 0.0;
+	_rttvar_ms = 0.0;
+	_timeout_ms = NODEREDTIME_TIMEOUT_MS;
+
+}
+
+
 bool NodeRedTime::serverTime(time_t * epoch) {
 
-	// required classes
-	WiFiClient client;
-	HTTPClient http;
+	// over budget (or told to back off)? serve extrapolated time (if any) instead
+	if (!syncAllowed()) {
 
-	// interpreted response from server (in integer milliseconds)
-	double serverTime_ms = 0.0;
+		return extrapolatedTime(epoch);
+
+	}
 
-	// for estimating millis() when server read its own time
-	unsigned long sync_ms = 0;
+	// try to send the query to the Node-Red server
+	if (!beginSync()) {
 
-	// try to obtain time from Node-Red server
-	if (http.begin(client, _url)) {
+		// unreachable - same outcome as an invalid reply
+		return acceptServerTime(0.0, millis(), epoch);
 
-		// uptime now
-		sync_ms = millis();
+	}
 
-		// send query
-		int httpCode = http.GET();
+	// wait for the reply (pollSync() enforces the timeout)
+	SyncStatus status;
+	while ((status = pollSync(epoch)) == SYNC_PENDING) {
 
-		/*
-		 *	mid-point of query round-trip time (floating
-		 *	point arithmetic to avoid wrap of unsigned
-		 *	integer arguments, guaranteed to yield a
-		 *	positive number, with implied truncation
-		 *	back to unsigned integer on the assignment)
-		 */
-		sync_ms = (1.0 * sync_ms + millis()) / 2.0;
+		yield();
+
+	}
 
-		// valid server reply?
-		if (httpCode == HTTP_CODE_OK) {
+	// turned away by a busy server? the last synchronisation still stands
+	if (status == SYNC_FAILED && _backoff) {
 
-			// yes! try to interpret reply
-			serverTime_ms = http.getString().toDouble();
+		return extrapolatedTime(epoch);
 
-		}
+	}
+
+	return (status == SYNC_SUCCEEDED);
 
-		http.end();
+}
+
+
+bool NodeRedTime::extrapolatedTime(time_t * epoch) {
+
+	double now_ms = 1.0 * millis();
+
+	if (_epochLastSync_ms >= _minEpoch_ms && now_ms > _uptimeLastSync_ms) {
+
+		*epoch = uptimeToEpoch_ms(now_ms) / 1000.0;
+		return true;
 
 	}
 
+	*epoch = 0;
+	return false;
+
+}
+
+
+bool NodeRedTime::acceptServerTime(
+	double serverTime_ms,
+	unsigned long sync_ms,
+	time_t * epoch
+) {
+
 	// valid response received from server?
 	if (serverTime_ms >= _minEpoch_ms) {
 
+		/*
+		 *	If deep sleeps have happened since the last real
+		 *	synchronisation, the time which really elapsed while
+		 *	asleep is now known. Compare with what was requested.
+		 */
+		if (_chainEpoch_ms > 0.0 && _chainRequested_ms >= 1000.0) {
+
+			double slept_ms =
+				(serverTime_ms - _chainEpoch_ms) -
+				_chainAwake_ms -
+				(sync_ms - _chainUptime_ms);
+
+			double ratio = slept_ms / _chainRequested_ms;
+
+			// ignore nonsense (eg a sleep not entered via calibratedSleep_us())
+			if (ratio > 0.5 && ratio < 2.0) {
+
+				_sleepRatio =
+					_sleepSamples == 0 ?
+					ratio :
+					0.75 * _sleepRatio + 0.25 * ratio;
+
+				_sleepSamples++;
+
+			}
+
+		}
+
+		// start a new chain
+		_chainEpoch_ms = serverTime_ms;
+		_chainUptime_ms = 1.0 * sync_ms;
+		_chainAwake_ms = 0.0;
+		_chainRequested_ms = 0.0;
+
         // record estimated synchronisation point
 		_uptimeLastSync_ms = 1.0 * sync_ms;
 
+		// the server read its clock somewhere within the round trip
+		_syncError_ms = max(
+			1.0 * (unsigned long)(sync_ms - _syncStart_ms),
+			1.0 * (unsigned long)(_syncReply_ms - sync_ms)
+		);
+		_sleepError_ms = 0.0;
+
         // remember the server's reply
 		_epochLastSync_ms = serverTime_ms;
 
+		// and any change of TAI-UTC it announced
+		if (_replyLeap_s > 0) {
+			setLeapSeconds(
+				_replyLeap_s,
+				_replyLeapEffective_s > 0 ? _replyLeapEffective_s : (time_t)(serverTime_ms / 1000.0)
+			);
+			_replyLeap_s = 0;
+		}
+		_syncGeneration++;
+
         // copy the server's reply in whole seconds to the caller
         // (implicit truncation to nearest second)
 		*epoch = serverTime_ms / 1000.0;
@@ -92,8 +233,11 @@ bool NodeRedTime::serverTime(time_t * epoch) {
 
 	}
 
-	// force future calls to syntheticTime to call serverTime()
-	_epochLastSync_ms = 0.0;
+	/*
+	 *	A failed query says nothing about the last synchronisation
+	 *	point, so it is kept. syntheticTime() goes back to the server
+	 *	once it leaves the recall period (or at once if there is none).
+	 */
 
 	// force sentinel value for the caller
 	*epoch = 0;
@@ -104,53 +248,1647 @@ bool NodeRedTime::serverTime(time_t * epoch) {
 }
 
 
+bool NodeRedTime::acceptSample(
+	double serverTime_ms,
+	unsigned long sent_ms,
+	unsigned long received_ms,
+	time_t * epoch
+) {
+
+	_syncStart_ms = sent_ms;
+	_syncReply_ms = received_ms;
+
+	return acceptServerTime(serverTime_ms, (1.0 * sent_ms + received_ms) / 2.0, epoch);
+
+}
+
+
 bool NodeRedTime::syntheticTime(time_t * epoch) {
 
-    // has valid time previously been obtained from NodeRed?
-	if (_epochLastSync_ms >= _minEpoch_ms) {
+	double epoch_ms;
+
+	if (syntheticMillis(&epoch_ms)) {
+
+		// whole seconds (implicit truncation to nearest second)
+		*epoch = epoch_ms / 1000.0;
+		return true;
+
+	}
+
+	// force sentinel value for the caller
+	*epoch = 0;
+	return false;
+
+}
+
+
+bool NodeRedTime::syntheticMillis(double * epoch_ms) {
+
+	// pick up a prediction left by calibratedSleep_us()
+	if (!_sleepRestored) {
+		restoreSleep();
+	}
+
+	/*
+	 *	Node-Red can answer if valid time has previously been
+	 *	obtained from it and millis() is still within the recall
+	 *	period. Otherwise either:
+	 *	1. serverTime() has never been called.
+	 *	2. serverTime() was called but did not supply a valid answer.
+	 *	3. serverTime() was called AND supplied a valid answer BUT
+	 *	   either millis() has wrapped or _recall_ms milliseconds
+	 *	   have since elapsed.
+	 *	and, unless SNTP is covering for a recent failure, Node-Red
+	 *	is asked again.
+	 */
+	bool nodeRed = errorBound_ms(SOURCE_NODERED) >= 0.0;
+	double nodeRed_ms = 0.0;
+
+	if (nodeRed) {
+
+		// extrapolate from the synchronisation point
+		nodeRed_ms = floor(uptimeToEpoch_ms(1.0 * millis()));
+
+	} else if (!failoverHolding()) {
+
+		/*
+		 *	serverTime() decides: it may have synchronised, or
+		 *	(over budget, backing off) extrapolated beyond the
+		 *	recall period.
+		 */
+		time_t epoch;
+		if (serverTime(&epoch)) {
+
+			nodeRed = true;
+			nodeRed_ms = floor(uptimeToEpoch_ms(1.0 * millis()));
+
+		} else if (errorBound_ms(SOURCE_SNTP) >= 0.0) {
+
+			// SNTP covers for a while before Node-Red is tried again
+			_failover = true;
+			_failoverStart_ms = millis();
+			_stats.failovers++;
+
+		}
+
+	}
+
+	// if both sources have time, the one with the smaller error bound wins
+	double sntpError_ms = errorBound_ms(SOURCE_SNTP);
+
+	if (sntpError_ms >= 0.0 && (!nodeRed || sntpError_ms < syncErrorBound_ms(1.0 * millis()))) {
+
+		*epoch_ms = floor(sntpMillis());
+		_lastSource = SOURCE_SNTP;
+		_stats.sntpSelections++;
+		return true;
+
+	}
+
+	if (nodeRed) {
+
+		*epoch_ms = nodeRed_ms;
+		_lastSource = SOURCE_NODERED;
+		return true;
+
+	}
+
+	_lastSource = SOURCE_NONE;
+	return false;
+
+}
+
+
+void NodeRedTime::useSntp(bool enable) {
+
+	_useSntp = enable;
+	_failover = false;
+
+	// register once; the callback stays harmless if disabled later
+	static bool registered = false;
+
+	if (!enable || registered) {
+		return;
+	}
+
+	registered = true;
+
+	#if (ESP8266)
+	settimeofday_cb([](bool fromSntp) {
+		if (fromSntp) {
+			NodeRedTime::sntpSynchronised();
+		}
+	});
+	#endif
+
+	#if (ESP32)
+	sntp_set_time_sync_notification_cb([](struct timeval *) {
+		NodeRedTime::sntpSynchronised();
+	});
+	#endif
+
+}
+
+
+void NodeRedTime::sntpSynchronised() {
+
+	sntpSync_ms = millis();
+	sntpValid = true;
+	sntpSyncCount = sntpSyncCount + 1;
+
+}
+
+
+double NodeRedTime::sntpMillis() {
+
+	struct timeval tv;
+	gettimeofday(&tv, nullptr);
+
+	return 1000.0 * tv.tv_sec + tv.tv_usec / 1000;
+
+}
+
+
+double NodeRedTime::errorBound_ms(TimeSource source) {
+
+	double now_ms = 1.0 * millis();
+
+	if (source == SOURCE_NODERED) {
 
-		// yes! the millisecond clock now is...
-		double now_ms = 1.0 * millis();
+		if (_epochLastSync_ms < _minEpoch_ms || !withinRecall(now_ms)) {
+			return -1.0;
+		}
+
+		return syncErrorBound_ms(now_ms);
+
+	}
+
+	if (source == SOURCE_SNTP) {
 
 		/*
-		 *	Conditions for calling serverTime() again are:
-		 *	1. millis() has wrapped; or
-		 *	2. _recall_ms has elapsed;
-		 *	3. both
-		 *	While the timeout calculation is wrap-safe, the
-		 *	rationale for forcing serverTime() when millis()
-		 *	wraps is because we don't know what else might
-		 *	happen under the ESP hood.
+		 *	The platform resynchronises on its own schedule (an
+		 *	hour by default), so allow two recall periods before
+		 *	giving up on a client which has stopped.
 		 */
-		if (
-			(now_ms > _uptimeLastSync_ms) &&
-			((long)(now_ms - (_uptimeLastSync_ms + _recall_ms)) < 0)
-		) {
+		unsigned long since_ms = millis() - sntpSync_ms;
+
+		if (!_useSntp || !sntpValid || since_ms >= 2.0 * _recall_ms) {
+			return -1.0;
+		}
+
+		return NODEREDTIME_SNTP_ERROR_MS + since_ms * NODEREDTIME_DRIFT_PPM / 1e6;
+
+	}
+
+	return -1.0;
+
+}
+
+
+double NodeRedTime::syncErrorBound_ms(double now_ms) {
+
+	// a reply in the same millisecond has had no time to drift
+	double since_ms = max(0.0, now_ms - _uptimeLastSync_ms);
+
+	return _syncError_ms + _sleepError_ms + since_ms * NODEREDTIME_DRIFT_PPM / 1e6;
+
+}
+
+
+bool NodeRedTime::failoverHolding() {
+
+	if (
+		_failover &&
+		(unsigned long)(millis() - _failoverStart_ms) < 1000UL * NODEREDTIME_FAILOVER_RETRY_S &&
+		errorBound_ms(SOURCE_SNTP) >= 0.0
+	) {
+		return true;
+	}
+
+	_failover = false;
+	return false;
+
+}
+
+
+/*
+ *	Unix times at which TAI-UTC stepped, from 10s at the start of
+ *	1972 (one more at each) to 37s at the start of 2017. Source:
+ *	IERS Bulletin C / leap-seconds.list.
+ */
+static const uint32_t leapSeconds[] PROGMEM = {
+	63072000,		// 1972-01-01  10
+	78796800,		// 1972-07-01  11
+	94694400,		// 1973-01-01  12
+	126230400,		// 1974-01-01  13
+	157766400,		// 1975-01-01  14
+	189302400,		// 1976-01-01  15
+	220924800,		// 1977-01-01  16
+	252460800,		// 1978-01-01  17
+	283996800,		// 1979-01-01  18
+	315532800,		// 1980-01-01  19
+	362793600,		// 1981-07-01  20
+	394329600,		// 1982-07-01  21
+	425865600,		// 1983-07-01  22
+	489024000,		// 1985-07-01  23
+	567993600,		// 1988-01-01  24
+	631152000,		// 1990-01-01  25
+	662688000,		// 1991-01-01  26
+	709948800,		// 1992-07-01  27
+	741484800,		// 1993-07-01  28
+	773020800,		// 1994-07-01  29
+	820454400,		// 1996-01-01  30
+	867715200,		// 1997-07-01  31
+	915148800,		// 1999-01-01  32
+	1136073600,		// 2006-01-01  33
+	1230768000,		// 2009-01-01  34
+	1341100800,		// 2012-07-01  35
+	1435708800,		// 2015-07-01  36
+	1483228800,		// 2017-01-01  37
+};
+
+static const int leapSecondsFirst_s = 10;
+
+// GPS time is TAI - 19s, counted from 1980-01-06T00:00:00 UTC
+static const int gpsMinusTai_s = -19;
+static const double gpsEpoch_ms = 315964800000.0;
+
+
+bool NodeRedTime::taiMillis(double * tai_ms) {
+
+	double utc_ms;
+
+	if (!syntheticMillis(&utc_ms)) {
+		return false;
+	}
+
+	*tai_ms = utc_ms + 1000.0 * taiOffset_s(utc_ms);
+	return true;
+
+}
+
+
+bool NodeRedTime::gpsMillis(double * gps_ms) {
+
+	double utc_ms;
+
+	if (!syntheticMillis(&utc_ms)) {
+		return false;
+	}
+
+	*gps_ms = utc_ms + 1000.0 * (taiOffset_s(utc_ms) + gpsMinusTai_s) - gpsEpoch_ms;
+	return true;
+
+}
 
-			// Safe to estimate epoch time by adding
-			// whole seconds elapsed since last Node-Red sync
-			// (implicit truncation to nearest second)
-			*epoch =
-				(now_ms + _epochLastSync_ms - _uptimeLastSync_ms) /
-				1000.0;
 
-       		// good to go
-			return true;
+int NodeRedTime::taiOffset_s(double utc_ms) const {
 
+	double utc_s = floor(utc_ms / 1000.0);
+
+	// a change announced by the server takes precedence from when it applies
+	if (_leapOffset_s != 0 && utc_s >= _leapEffective_s) {
+		return _leapOffset_s;
+	}
+
+	// the table only grows at the end, so search backwards
+	const size_t count = sizeof(leapSeconds) / sizeof(leapSeconds[0]);
+
+	for (size_t i = count; i > 0; i--) {
+
+		if (utc_s >= pgm_read_dword(&leapSeconds[i - 1])) {
+			return leapSecondsFirst_s + (i - 1);
 		}
- 
+
+	}
+
+	return leapSecondsFirst_s;
+
+}
+
+
+void NodeRedTime::setLeapSeconds(int taiMinusUtc_s, time_t effective_s) {
+
+	_leapOffset_s = taiMinusUtc_s;
+	_leapEffective_s = effective_s;
+
+}
+
+
+bool NodeRedTime::hlcNow(uint64_t * hlc) {
+
+	double physical_ms = 0.0;
+	bool valid = syntheticMillis(&physical_ms);
+
+	_hlc = hlcAdvance(_hlc, physical_ms);
+
+	*hlc = _hlc;
+	return valid;
+
+}
+
+
+bool NodeRedTime::hlcReceive(uint64_t remote, uint64_t * hlc) {
+
+	double physical_ms = 0.0;
+	bool valid = syntheticMillis(&physical_ms);
+
+	// a sender far ahead of real time is wrong, not early
+	if (valid && hlcMillis(remote) > physical_ms + NODEREDTIME_HLC_MAX_OFFSET_MS) {
+
+		_stats.hlcRejects++;
+		_hlc = hlcAdvance(_hlc, physical_ms);
+
+		*hlc = _hlc;
+		return false;
+
 	}
 
+	// the later of our clock and the sender's, then advance past both
+	uint64_t latest = max(_hlc, remote);
+
+	_hlc = hlcAdvance(latest, physical_ms);
+
+	*hlc = _hlc;
+	return valid;
+
+}
+
+
+uint64_t NodeRedTime::hlcAdvance(uint64_t hlc, double physical_ms) {
+
+	uint64_t physical = (uint64_t)physical_ms << 16;
+
+	/*
+	 *	Physical time ahead of the logical clock: adopt it with a
+	 *	zero counter. Otherwise stay on the logical clock's
+	 *	millisecond and bump the counter. A counter overflow
+	 *	simply carries into the millisecond field, which keeps
+	 *	timestamps unique and ordered.
+	 */
+	return (physical > hlc) ? physical : hlc + 1;
+
+}
+
+
+bool NodeRedTime::withinRecall(double now_ms) {
+
 	/*
-	 * Arriving here means either:
-	 * 1. serverTime() has never been called.
-	 * 2. serverTime() was called but did not supply a valid answer.
-	 * 3. serverTime() was called AND supplied a valid answer BUT
-	 *    either millis() has wrapped or _recall_ms milliseconds
-	 *	  have since elapsed.
+	 *	Conditions for calling serverTime() again are:
+	 *	1. millis() has wrapped; or
+	 *	2. _recall_ms has elapsed;
+	 *	3. both
+	 *	While the timeout calculation is wrap-safe, the
+	 *	rationale for forcing serverTime() when millis()
+	 *	wraps is because we don't know what else might
+	 *	happen under the ESP hood.
 	 */
+	return
+		(now_ms > _uptimeLastSync_ms) &&
+		((long)(now_ms - (_uptimeLastSync_ms + _recall_ms)) < 0);
+
+}
+
+
+double NodeRedTime::uptimeToEpoch_ms(double uptime_ms) {
+
+	// elapsed since the synchronisation point, added to the server's time
+	return uptime_ms + _epochLastSync_ms - _uptimeLastSync_ms;
+
+}
+
+
+bool NodeRedTime::beginSync() {
+
+	// calibration learns from the first synchronisation after waking
+	if (!_sleepRestored) {
+		restoreSleep();
+	}
+
+	// abandon anything already in progress
+	if (_syncStatus == SYNC_PENDING) {
+		_client->stop();
+	}
+	_syncStatus = SYNC_IDLE;
+
+	// over budget (or told to back off)?
+	if (!syncAllowed()) {
+
+		return false;
+
+	}
+
+	_stats.syncAttempts++;
+	_syncBegin_ms = millis();
+
+	#if (NODEREDTIME_HEAP_STATS)
+	recordHeap(false);
+	#endif
+
+	// CoAP has its own path
+	if (_coap) {
+
+		return beginCoap();
+
+	}
+
+	// reuse a connection opened by prepare(), otherwise open one now
+	if (!_client->connected() && !connectToServer()) {
+
+		syncFinished(false);
+		return false;
+
+	}
+
+	/*
+	 *	The smallest valid HTTP/1.1 request. Host is the only
+	 *	mandatory header (and must carry a non-default port).
+	 *	Everything HTTPClient adds (User-Agent, Connection,
+	 *	Accept-Encoding) is irrelevant to a 13-digit reply.
+	 */
+	char request[NODEREDTIME_REQUEST_SIZE];
+	int length = (_port != (_secure ? 443 : 80)) ?
+		snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: %s:%u\r\n\r\n", _path.c_str(), _host.c_str(), _port) :
+		snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: %s\r\n\r\n", _path.c_str(), _host.c_str());
+
+	// built in place (no heap), so a URL which does not fit can't be sent
+	if (length < 0 || length >= (int)sizeof(request)) {
+
+		_client->stop();
+		syncFinished(false);
+		return false;
+
+	}
+
+	// uptime now
+	_syncStart_ms = millis();
+	_syncReply_ms = _syncStart_ms;
+
+	// send query (in one write, so in one segment)
+	if (_client->write((const uint8_t *)request, length) != (size_t)length) {
+
+		_client->stop();
+		syncFinished(false);
+		return false;
+
+	}
+
+	// reset the reply parser
+	_replyState = REPLY_STATUS;
+	_replyStatus = 0;
+	_retryAfter_s = 0;
+	_replyLeap_s = 0;
+	_replyLeapEffective_s = 0;
+	_lineLength = 0;
+	_contentLength = -1;
+	_bodyLength = 0;
+
+	_syncStatus = SYNC_PENDING;
+	return true;
+
+}
+
+
+bool NodeRedTime::prepare() {
+
+	// already open (and not in use)?
+	if (_syncStatus != SYNC_PENDING && _client->connected()) {
+
+		return true;
+
+	}
+
+	// can't do anything until the interface has an IP address
+	if (_syncStatus == SYNC_PENDING || WiFi.status() != WL_CONNECTED) {
+
+		return false;
+
+	}
+
+	return _coap ? openCoap() : connectToServer();
+
+}
+
+
+bool NodeRedTime::connectToServer() {
+
+	// TLS has its own path
+	if (_secure) {
+
+		return connectSecure();
+
+	}
+
+	// resolve the server name unless already known
+	if (!_serverIPValid) {
+
+		_serverIPValid = WiFi.hostByName(_host.c_str(), _serverIP) == 1;
+
+		if (!_serverIPValid) {
+			return false;
+		}
+
+	}
+
+	// try to reach the Node-Red server
+	#if (ESP32)
+	int connected = _plainClient.connect(_serverIP, _port, _timeout_ms);
+	#else
+	_plainClient.setTimeout(_timeout_ms);
+	int connected = _plainClient.connect(_serverIP, _port);
+	#endif
+
+	if (!connected) {
+
+		/*
+		 *	the server may have moved - resolve again next time
+		 *	(and treat the failure like any other timeout)
+		 */
+		_serverIPValid = false;
+		updateRoundTrip(-1.0);
+		return false;
+
+	}
+
+	return true;
+
+}
+
+
+bool NodeRedTime::connectSecure() {
+
+	#if (ESP8266)
+
+	// the session survives deep sleep in RTC memory
+	if (!_sessionRestored) {
+		restoreSession();
+		_sessionRestored = true;
+	}
+
+	// BearSSL resumes the session if the server still knows it
+	_secureClient.setSession(&_session);
+
+	if (_trustAnchors) {
+		_secureClient.setTrustAnchors(_trustAnchors);
+	} else {
+		_secureClient.setInsecure();
+	}
+
+	_secureClient.setTimeout(_timeout_ms);
+	int connected = _secureClient.connect(_host.c_str(), _port);
+
+	#endif
+
+	#if (ESP32)
+
+	if (_rootCA) {
+		_secureClient.setCACert(_rootCA);
+	} else {
+		_secureClient.setInsecure();
+	}
+
+	int connected = _secureClient.connect(_host.c_str(), _port, _timeout_ms);
+
+	#endif
+
+	if (!connected) {
+
+		updateRoundTrip(-1.0);
+		return false;
+
+	}
+
+	#if (ESP8266)
+
+	// the handshake may have issued a new session
+	saveSession();
+
+	#endif
+
+	return true;
+
+}
+
+
+void NodeRedTime::setRootCA(const char * rootCA) {
+
+	#if (ESP8266)
+
+	delete _trustAnchors;
+	_trustAnchors = new BearSSL::X509List(rootCA);
+
+	#endif
+
+	#if (ESP32)
+
+	_rootCA = rootCA;
+
+	#endif
+
+}
+
+
+#if (ESP8266)
+
+/*
+ *	Layout of the TLS session in RTC user memory. The check
+ *	word is a hash of the session parameters, so anything
+ *	else left in RTC memory (eg after a cold boot) is ignored.
+ */
+struct NodeRedTimeRTCSession {
+	uint32_t check;
+	br_ssl_session_parameters session;
+};
+
+
+static uint32_t rtcCheck(const br_ssl_session_parameters * session) {
+
+	// FNV-1a, seeded so that all-zero memory does not pass
+	uint32_t hash = 0x811C9DC5 ^ 0x4E525454;
+	const uint8_t * p = (const uint8_t *)session;
+
+	for (size_t i = 0; i < sizeof(*session); i++) {
+		hash = (hash ^ p[i]) * 0x01000193;
+	}
+
+	return hash;
+
+}
+
+
+void NodeRedTime::saveSession() {
+
+	NodeRedTimeRTCSession rtc;
+
+	rtc.session = *_session.getSession();
+	rtc.check = rtcCheck(&rtc.session);
+
+	ESP.rtcUserMemoryWrite(NODEREDTIME_RTC_OFFSET, (uint32_t *)&rtc, sizeof(rtc));
+
+}
+
+
+void NodeRedTime::restoreSession() {
+
+	NodeRedTimeRTCSession rtc;
+
+	if (
+		ESP.rtcUserMemoryRead(NODEREDTIME_RTC_OFFSET, (uint32_t *)&rtc, sizeof(rtc)) &&
+		rtc.check == rtcCheck(&rtc.session)
+	) {
+
+		*_session.getSession() = rtc.session;
+
+	}
+
+}
+
+#endif
+
+
+NodeRedTime::SyncStatus NodeRedTime::pollSync(time_t * epoch) {
+
+	// nothing in progress?
+	if (_syncStatus != SYNC_PENDING) {
+
+		return _syncStatus;
+
+	}
+
+	// CoAP has its own path
+	if (_coap) {
+
+		return pollCoap(epoch);
+
+	}
+
+	// consume whatever has arrived (never waits)
+	bool usable = true;
+	while (usable && _client->available() > 0) {
+
+		int c = _client->read();
+
+		if (c < 0) {
+			break;
+		}
+
+		// the first byte of the reply closes the round trip
+		if (_replyState == REPLY_STATUS && _lineLength == 0) {
+			_syncReply_ms = millis();
+		}
+
+		usable = consumeReply(c);
+
+	}
+
+	/*
+	 *	The reply is complete when Content-Length bytes of body
+	 *	have arrived. The server may keep the connection open
+	 *	(HTTP/1.1 default) so waiting for it to close would only
+	 *	add latency. Without Content-Length, fall back to waiting
+	 *	for the close.
+	 */
+	bool complete =
+		_replyState == REPLY_BODY &&
+		_contentLength >= 0 &&
+		_bodyLength >= (size_t)_contentLength;
+
+	// has the server finished (or has the reply been rejected)?
+	if (usable && !complete && _client->connected()) {
+
+		// no! give up if the server is taking too long
+		if ((long)(millis() - (_syncStart_ms + _timeout_ms)) < 0) {
+
+			return SYNC_PENDING;
+
+		}
+
+		updateRoundTrip(-1.0);
+		usable = false;
+
+	} else if (_syncReply_ms != _syncStart_ms) {
+
+		// something arrived so the round trip can be measured
+		updateRoundTrip(1.0 * (_syncReply_ms - _syncStart_ms));
+
+	}
+
+	_client->stop();
+
+	// interpreted response from server (in integer milliseconds)
+	double serverTime_ms = 0.0;
+
+	if (usable && _replyStatus == 503) {
+
+		// shedding load - stay away for as long as asked
+		serverBusy(_retryAfter_s > 0 ? _retryAfter_s : NODEREDTIME_RETRY_AFTER_S);
+		return syncRefused(epoch);
+
+	} else if (usable && _replyState == REPLY_BODY) {
+
+		_line[_lineLength] = '\0';
+		serverTime_ms = atof(_line);
+
+	}
+
+	/*
+	 *	mid-point of query round-trip time (floating
+	 *	point arithmetic to avoid wrap of unsigned
+	 *	integer arguments, guaranteed to yield a
+	 *	positive number, with implied truncation
+	 *	back to unsigned integer on the assignment)
+	 */
+	unsigned long sync_ms = (1.0 * _syncStart_ms + _syncReply_ms) / 2.0;
+
+	// completion is reported once, then back to idle
+	_syncStatus = SYNC_IDLE;
+
+	bool valid = acceptServerTime(serverTime_ms, sync_ms, epoch);
+
+	syncFinished(valid);
+
+	return valid ? SYNC_SUCCEEDED : SYNC_FAILED;
+
+}
+
+
+NodeRedTime::SyncStatus NodeRedTime::syncRefused(time_t * epoch) {
+
+	// completion is reported once, then back to idle
+	_syncStatus = SYNC_IDLE;
+
+	// no new time, but the last synchronisation point is kept
+	*epoch = 0;
+
+	syncFinished(false);
+
+	return SYNC_FAILED;
+
+}
+
+
+bool NodeRedTime::openCoap() {
+
+	// resolve the server name unless already known
+	if (!_serverIPValid) {
+
+		_serverIPValid = WiFi.hostByName(_host.c_str(), _serverIP) == 1;
+
+		if (!_serverIPValid) {
+			return false;
+		}
+
+	}
+
+	// any local port will do
+	if (!_udpOpen) {
+
+		_udpOpen = _udp.begin(0) == 1;
+
+	}
+
+	return _udpOpen;
+
+}
+
+
+bool NodeRedTime::beginCoap() {
+
+	if (!openCoap()) {
+
+		syncFinished(false);
+		return false;
+
+	}
+
+	// discard anything left over from an earlier request
+	while (_udp.parsePacket() > 0) {
+	}
+
+	// message IDs run on from a random start (RFC 7252 section 4.4)
+	if (_coapMessageId == 0) {
+		_coapMessageId = random(1, 0x10000);
+	}
+	_coapMessageId++;
+	_coapToken = random(0x7FFFFFFF);
+
+	/*
+	 *	Header: version 1, type CON (0) or NON (1), 4-byte token,
+	 *	code 0.01 (GET), message ID. Then one Uri-Path option
+	 *	(number 11) per path segment - the first with delta 11,
+	 *	the rest with delta 0.
+	 */
+	size_t n = 0;
+	_coapRequest[n++] = 0x40 | (_confirmable ? 0x00 : 0x10) | sizeof(_coapToken);
+	_coapRequest[n++] = 0x01;
+	_coapRequest[n++] = _coapMessageId >> 8;
+	_coapRequest[n++] = _coapMessageId & 0xFF;
+	for (size_t i = 0; i < sizeof(_coapToken); i++) {
+		_coapRequest[n++] = _coapToken >> (8 * i);
+	}
+
+	unsigned int delta = 11;
+	int start = 0;
+
+	while (start < (int)_path.length()) {
+
+		int end = _path.indexOf('/', start);
+		if (end < 0) {
+			end = _path.length();
+		}
+
+		size_t length = end - start;
+
+		if (length > 0) {
+
+			// lengths over 12 take an extra byte (up to 268)
+			if (length > 268 || n + 2 + length > sizeof(_coapRequest)) {
+
+				syncFinished(false);
+				return false;
+
+			}
+
+			if (length < 13) {
+				_coapRequest[n++] = (delta << 4) | length;
+			} else {
+				_coapRequest[n++] = (delta << 4) | 13;
+				_coapRequest[n++] = length - 13;
+			}
+
+			memcpy(_coapRequest + n, _path.c_str() + start, length);
+			n += length;
+			delta = 0;
+
+		}
+
+		start = end + 1;
+
+	}
+
+	_coapRequestLength = n;
+	_coapTransmissions = 0;
+	_coapAcknowledged = false;
+
+	// first wait is the timeout plus up to 50% jitter (RFC 7252 ACK_RANDOM_FACTOR)
+	_coapWait_ms = _timeout_ms + (_confirmable ? random(_timeout_ms / 2 + 1) : 0);
+
+	if (!sendCoap()) {
+
+		syncFinished(false);
+		return false;
+
+	}
+
+	_lineLength = 0;
+	_syncStatus = SYNC_PENDING;
+	return true;
+
+}
+
+
+bool NodeRedTime::sendCoap() {
+
+	_syncStart_ms = millis();
+	_syncReply_ms = _syncStart_ms;
+	_coapTransmissions++;
+
+	return
+		_udp.beginPacket(_serverIP, _port) == 1 &&
+		_udp.write(_coapRequest, _coapRequestLength) == _coapRequestLength &&
+		_udp.endPacket() == 1;
+
+}
+
+
+NodeRedTime::SyncStatus NodeRedTime::pollCoap(time_t * epoch) {
+
+	CoapOutcome outcome = COAP_IGNORE;
+	bool ok = false;
+
+	// consume whatever has arrived (never waits)
+	while (outcome != COAP_RESPONSE && outcome != COAP_BUSY && _udp.parsePacket() > 0) {
+
+		unsigned long arrived_ms = millis();
+
+		uint8_t packet[NODEREDTIME_COAP_SIZE];
+		int length = _udp.read(packet, sizeof(packet));
+
+		// only the server can answer
+		bool fromServer = _udp.remoteIP() == _serverIP && _udp.remotePort() == _port;
+		if (length <= 0 || !fromServer) {
+			continue;
+		}
+
+		outcome = parseCoap(packet, length, &ok);
+
+		if (outcome == COAP_ACKNOWLEDGED && !_coapAcknowledged) {
+
+			_coapAcknowledged = true;
+			_coapAck_ms = arrived_ms;
+
+		} else if (outcome == COAP_RESPONSE || outcome == COAP_BUSY) {
+
+			_syncReply_ms = arrived_ms;
+
+		}
+
+	}
+
+	// shedding load - parseCoap() has started the back-off
+	if (outcome == COAP_BUSY) {
+		return syncRefused(epoch);
+	}
+
+	if (outcome != COAP_RESPONSE) {
+
+		// a separate response may take longer than a round trip
+		if (_coapAcknowledged) {
+
+			if ((long)(millis() - (_coapAck_ms + NODEREDTIME_TIMEOUT_MS)) < 0) {
+				return SYNC_PENDING;
+			}
+
+		} else if ((long)(millis() - (_syncStart_ms + _coapWait_ms)) < 0) {
+
+			return SYNC_PENDING;
+
+		} else if (_confirmable && _coapTransmissions <= NODEREDTIME_COAP_RETRANSMIT) {
+
+			// no reply - send again and wait twice as long
+			_coapWait_ms = min(2 * _coapWait_ms, (unsigned long)NODEREDTIME_TIMEOUT_MS);
+			_stats.coapRetransmits++;
+
+			if (sendCoap()) {
+				return SYNC_PENDING;
+			}
+
+		}
+
+		updateRoundTrip(-1.0);
+		ok = false;
+
+	}
+
+	// interpreted response from server (in integer milliseconds)
+	double serverTime_ms = 0.0;
+	unsigned long sync_ms = millis();
+
+	if (ok) {
+
+		_line[_lineLength] = '\0';
+		serverTime_ms = atof(_line);
+
+		/*
+		 *	Karn's algorithm: if the request was sent more than
+		 *	once, the reply can't be matched to a transmission,
+		 *	so it says nothing about the round-trip time.
+		 */
+		unsigned long network_ms = (_coapAcknowledged ? _coapAck_ms : _syncReply_ms) - _syncStart_ms;
+
+		if (_coapTransmissions == 1) {
+			updateRoundTrip(1.0 * network_ms);
+		}
+
+		/*
+		 *	Piggybacked reply: the server read its clock at the
+		 *	mid-point of the round trip, as for http. Separate
+		 *	response: it read its clock when it sent the reply,
+		 *	roughly half a round trip before it arrived.
+		 */
+		sync_ms = _coapAcknowledged ?
+			_syncReply_ms - network_ms / 2 :
+			(1.0 * _syncStart_ms + _syncReply_ms) / 2.0;
+
+	}
+
+	// completion is reported once, then back to idle
+	_syncStatus = SYNC_IDLE;
+
+	bool valid = acceptServerTime(serverTime_ms, sync_ms, epoch);
+
+	syncFinished(valid);
+
+	return valid ? SYNC_SUCCEEDED : SYNC_FAILED;
+
+}
+
+
+NodeRedTime::CoapOutcome NodeRedTime::parseCoap(const uint8_t * packet, size_t length, bool * ok) {
+
+	*ok = false;
+
+	// version 1, at least a header
+	if (length < 4 || (packet[0] >> 6) != 1) {
+		return COAP_IGNORE;
+	}
+
+	uint8_t type = (packet[0] >> 4) & 0x03;
+	size_t tokenLength = packet[0] & 0x0F;
+	uint8_t code = packet[1];
+	uint16_t messageId = (packet[2] << 8) | packet[3];
+
+	// ACK and RST answer our message ID
+	if ((type == 2 || type == 3) && messageId != _coapMessageId) {
+		return COAP_IGNORE;
+	}
+
+	// RST - the server refused the request
+	if (type == 3) {
+		return COAP_RESPONSE;
+	}
+
+	// empty ACK - the server will send a separate response
+	if (type == 2 && code == 0x00) {
+		return COAP_ACKNOWLEDGED;
+	}
+
+	// a response must echo our token
+	if (tokenLength != sizeof(_coapToken) || length < 4 + tokenLength) {
+		return COAP_IGNORE;
+	}
+	for (size_t i = 0; i < tokenLength; i++) {
+		if (packet[4 + i] != (uint8_t)(_coapToken >> (8 * i))) {
+			return COAP_IGNORE;
+		}
+	}
+
+	// a confirmable separate response must itself be acknowledged
+	if (type == 0) {
+		uint8_t ack[4] = { 0x60, 0x00, packet[2], packet[3] };
+		_udp.beginPacket(_serverIP, _port);
+		_udp.write(ack, sizeof(ack));
+		_udp.endPacket();
+	}
+
+	// anything but 2.05 Content or 5.03 Service Unavailable is a failure
+	if (code != 0x45 && code != 0xA3) {
+		return COAP_RESPONSE;
+	}
+
+	// walk the options (delta and length nibbles, with extensions)
+	size_t i = 4 + tokenLength;
+	unsigned int option = 0;
+	unsigned long maxAge_s = NODEREDTIME_RETRY_AFTER_S;
+
+	while (i < length && packet[i] != 0xFF) {
+
+		unsigned int delta = packet[i] >> 4;
+		size_t optionLength = packet[i] & 0x0F;
+		i++;
+
+		if (delta == 15 || optionLength == 15) {
+			return COAP_RESPONSE;
+		}
+
+		if (delta == 13 && i < length) {
+			delta = 13 + packet[i++];
+		} else if (delta == 14 && i + 1 < length) {
+			delta = 269 + ((packet[i] << 8) | packet[i + 1]);
+			i += 2;
+		}
+
+		if (optionLength == 13 && i < length) {
+			optionLength = 13 + packet[i++];
+		} else if (optionLength == 14 && i + 1 < length) {
+			optionLength = 269 + ((packet[i] << 8) | packet[i + 1]);
+			i += 2;
+		}
+
+		option += delta;
+
+		// Max-Age (14): how long a 5.03 asks us to stay away
+		if (option == 14 && optionLength <= 4 && i + optionLength <= length) {
+			maxAge_s = 0;
+			for (size_t j = 0; j < optionLength; j++) {
+				maxAge_s = (maxAge_s << 8) | packet[i + j];
+			}
+		}
+
+		i += optionLength;
+
+	}
+
+	// shedding load - the equivalent of HTTP 503 and Retry-After
+	if (code == 0xA3) {
+		serverBusy(maxAge_s);
+		return COAP_BUSY;
+	}
+
+	// payload (a number, so any excess is truncated)
+	_lineLength = 0;
+
+	if (i < length) {
+		for (i++; i < length && _lineLength < sizeof(_line) - 1; i++) {
+			_line[_lineLength++] = packet[i];
+		}
+	}
+
+	*ok = _lineLength > 0;
+	return COAP_RESPONSE;
+
+}
+
+
+/*
+ *	What calibratedSleep_us() leaves for the next boot. The check
+ *	word is a hash of the rest of the record, so anything else left
+ *	in RTC memory (eg after a cold boot) is ignored.
+ */
+struct NodeRedTimeRTCSleep {
+	uint32_t check;
+	uint32_t samples;
+	double ratio;
+	double chainEpoch_ms;
+	double chainAwake_ms;
+	double chainRequested_ms;
+	double syncError_ms;
+};
+
+
+static uint32_t rtcSleepCheck(const NodeRedTimeRTCSleep * sleep) {
+
+	// FNV-1a over everything after the check word
+	uint32_t hash = 0x811C9DC5 ^ 0x4E52534C;
+	const uint8_t * p = (const uint8_t *)sleep + sizeof(sleep->check);
+
+	for (size_t i = sizeof(sleep->check); i < sizeof(*sleep); i++) {
+		hash = (hash ^ *p++) * 0x01000193;
+	}
+
+	return hash;
+
+}
+
+
+#if (ESP32)
+
+// survives deep sleep (zeroed on power-up, so the check fails)
+RTC_DATA_ATTR static NodeRedTimeRTCSleep rtcSleep;
+
+#endif
+
+
+#if (ESP8266)
+
+uint32_t NodeRedTime::rtcFreeBlock() {
+
+	return
+		NODEREDTIME_RTC_OFFSET +
+		(sizeof(NodeRedTimeRTCSession) + 3) / 4 +
+		(sizeof(NodeRedTimeRTCSleep) + 3) / 4;
+
+}
+
+#endif
+
+
+uint64_t NodeRedTime::calibratedSleep_us(double desired_s) {
+
+	if (!_sleepRestored) {
+		restoreSleep();
+	}
+
+	// what the timer must be asked for to produce desired_s
+	double requested_ms = 1000.0 * desired_s / _sleepRatio;
+
+	NodeRedTimeRTCSleep rtc;
+
+	rtc.samples = _sleepSamples;
+	rtc.ratio = _sleepRatio;
+	rtc.chainEpoch_ms = _chainEpoch_ms;
+	rtc.chainAwake_ms = _chainAwake_ms + (1.0 * millis() - _chainUptime_ms);
+	rtc.chainRequested_ms = _chainRequested_ms + requested_ms;
+	rtc.syncError_ms = _syncError_ms;
+	rtc.check = rtcSleepCheck(&rtc);
+
+	#if (ESP8266)
+	ESP.rtcUserMemoryWrite(
+		NODEREDTIME_RTC_OFFSET + (sizeof(NodeRedTimeRTCSession) + 3) / 4,
+		(uint32_t *)&rtc,
+		sizeof(rtc)
+	);
+	#endif
+
+	#if (ESP32)
+	rtcSleep = rtc;
+	#endif
+
+	return 1000.0 * requested_ms;
+
+}
+
+
+void NodeRedTime::restoreSleep() {
+
+	_sleepRestored = true;
+
+	NodeRedTimeRTCSleep rtc;
+
+	#if (ESP8266)
+	const uint32_t offset = NODEREDTIME_RTC_OFFSET + (sizeof(NodeRedTimeRTCSession) + 3) / 4;
+	if (!ESP.rtcUserMemoryRead(offset, (uint32_t *)&rtc, sizeof(rtc))) {
+		return;
+	}
+	#endif
+
+	#if (ESP32)
+	rtc = rtcSleep;
+	#endif
+
+	if (rtc.check != rtcSleepCheck(&rtc)) {
+		return;
+	}
+
+	// consume the record so a later uncalibrated sleep can't reuse it
+	#if (ESP8266)
+	uint32_t invalid = 0;
+	ESP.rtcUserMemoryWrite(offset, &invalid, sizeof(invalid));
+	#endif
+
+	#if (ESP32)
+	rtcSleep.check = 0;
+	#endif
+
+	_sleepRatio = rtc.ratio;
+	_sleepSamples = rtc.samples;
+	_chainEpoch_ms = rtc.chainEpoch_ms;
+	_chainUptime_ms = 0.0;
+	_chainAwake_ms = rtc.chainAwake_ms;
+	_chainRequested_ms = rtc.chainRequested_ms;
+
+	/*
+	 *	Once calibrated, predict. The synchronisation point
+	 *	stays at the last real synchronisation, placed before
+	 *	this boot by the predicted time since then, so that
+	 *	withinRecall() still measures from the real one.
+	 */
+	if (_chainEpoch_ms >= _minEpoch_ms && _sleepSamples >= NODEREDTIME_SLEEP_SAMPLES) {
+
+		_epochLastSync_ms = _chainEpoch_ms;
+		_uptimeLastSync_ms = -(_chainAwake_ms + _chainRequested_ms * _sleepRatio);
+		_syncError_ms = rtc.syncError_ms;
+		_sleepError_ms = _chainRequested_ms * _sleepRatio * NODEREDTIME_SLEEP_DRIFT_PPM / 1e6;
+		_syncGeneration++;
+
+	}
+
+}
+
+
+const NodeRedTime::Stats & NodeRedTime::stats() {
+
+	_stats.srtt_ms = _srtt_ms;
+	_stats.rttvar_ms = _rttvar_ms;
+	_stats.timeout_ms = _timeout_ms;
+	_stats.sntpSyncs = sntpSyncCount;
+
+	// budget used, as budgetAvailable() sees it
+	rollBudgetWindow();
+	double weight = budgetWeight();
+	_stats.budgetSyncs = _windowSyncs[1] * weight + _windowSyncs[0];
+	_stats.budgetNetwork_ms = _windowNetwork_ms[1] * weight + _windowNetwork_ms[0];
+
+	return _stats;
+
+}
+
+
+void NodeRedTime::syncFinished(bool valid) {
+
+	if (!valid) {
+		_stats.syncFailures++;
+	}
+
+	// charge the budget (if any) for this synchronisation
+	if (_budgetWindow_ms > 0) {
+		rollBudgetWindow();
+		_windowSyncs[0] += 1.0;
+		_windowNetwork_ms[0] += 1.0 * (millis() - _syncBegin_ms);
+	}
+
+	#if (NODEREDTIME_HEAP_STATS)
+	recordHeap(true);
+	#endif
+
+}
+
+
+void NodeRedTime::setSyncBudget(
+	unsigned int maxSyncs,
+	unsigned long maxNetwork_ms,
+	unsigned long window_s
+) {
+
+	_budgetSyncs = maxSyncs;
+	_budgetNetwork_ms = maxNetwork_ms;
+	_budgetWindow_ms = 1000UL * window_s;
+
+	// start afresh
+	_windowStart_ms = millis();
+	_windowSyncs[0] = _windowSyncs[1] = 0.0;
+	_windowNetwork_ms[0] = _windowNetwork_ms[1] = 0.0;
+
+}
+
+
+void NodeRedTime::rollBudgetWindow() {
+
+	if (_budgetWindow_ms == 0) {
+		return;
+	}
+
+	unsigned long elapsed_ms = millis() - _windowStart_ms;
+
+	if (elapsed_ms < _budgetWindow_ms) {
+		return;
+	}
+
+	// the current window becomes the previous one (or both empty)
+	if (elapsed_ms < 2 * _budgetWindow_ms) {
+		_windowSyncs[1] = _windowSyncs[0];
+		_windowNetwork_ms[1] = _windowNetwork_ms[0];
+	} else {
+		_windowSyncs[1] = 0.0;
+		_windowNetwork_ms[1] = 0.0;
+	}
+
+	_windowSyncs[0] = 0.0;
+	_windowNetwork_ms[0] = 0.0;
+
+	_windowStart_ms += elapsed_ms - (elapsed_ms % _budgetWindow_ms);
+
+}
+
+
+double NodeRedTime::budgetWeight() {
+
+	if (_budgetWindow_ms == 0) {
+		return 0.0;
+	}
+
+	// the part of the previous window still inside the rolling window
+	return 1.0 - 1.0 * (millis() - _windowStart_ms) / _budgetWindow_ms;
+
+}
+
+
+bool NodeRedTime::syncAllowed() {
+
+	// still inside a back-off requested by the server?
+	if (_backoff && (unsigned long)(millis() - _backoffStart_ms) < _backoff_ms) {
+
+		_stats.backoffDenials++;
+		return false;
+
+	}
+
+	_backoff = false;
+
+	if (!budgetAvailable()) {
+
+		_stats.budgetDenials++;
+		return false;
+
+	}
+
+	return true;
+
+}
+
+
+void NodeRedTime::serverBusy(unsigned long retryAfter_s) {
+
+	/*
+	 *	Honour the server's request, plus up to 25% so that a
+	 *	fleet which was turned away together doesn't return
+	 *	together.
+	 */
+	unsigned long backoff_ms = 1000UL * min(retryAfter_s, (unsigned long)NODEREDTIME_RETRY_AFTER_MAX_S);
+
+	_backoff = true;
+	_backoffStart_ms = millis();
+	_backoff_ms = backoff_ms + random(backoff_ms / 4 + 1);
+
+	_stats.serverBackoffs++;
+
+}
+
+
+bool NodeRedTime::budgetAvailable() {
+
+	// no budget set?
+	if (_budgetWindow_ms == 0) {
+		return true;
+	}
+
+	rollBudgetWindow();
+	double weight = budgetWeight();
+
+	if (
+		_budgetSyncs > 0 &&
+		_windowSyncs[1] * weight + _windowSyncs[0] >= _budgetSyncs
+	) {
+		return false;
+	}
+
+	if (
+		_budgetNetwork_ms > 0 &&
+		_windowNetwork_ms[1] * weight + _windowNetwork_ms[0] >= _budgetNetwork_ms
+	) {
+		return false;
+	}
+
+	return true;
+
+}
+
+
+#if (NODEREDTIME_HEAP_STATS)
+
+void NodeRedTime::recordHeap(bool after) {
+
+	uint32_t heap = ESP.getFreeHeap();
+
+	#if (ESP8266)
+	uint32_t block = ESP.getMaxFreeBlockSize();
+	#endif
+
+	#if (ESP32)
+	uint32_t block = ESP.getMaxAllocHeap();
+	#endif
+
+	if (after) {
+
+		_stats.heapAfter = heap;
+		_stats.blockAfter = block;
+
+		// both report the low-water mark of the running task's stack
+		#if (ESP8266)
+		_stats.stackHighWater = ESP.getFreeContStack();
+		#endif
+
+		#if (ESP32)
+		_stats.stackHighWater = uxTaskGetStackHighWaterMark(NULL);
+		#endif
+
+	} else {
+
+		_stats.heapBefore = heap;
+		_stats.blockBefore = block;
+
+	}
+
+	if (_stats.heapLowest == 0 || heap < _stats.heapLowest) {
+		_stats.heapLowest = heap;
+	}
+
+	if (_stats.blockLowest == 0 || block < _stats.blockLowest) {
+		_stats.blockLowest = block;
+	}
+
+}
+
+#endif
+
+
+void NodeRedTime::updateRoundTrip(double rtt_ms) {
+
+	if (rtt_ms < 0.0) {
+
+		// timed out - back off
+		_timeout_ms = min(2 * _timeout_ms, (unsigned long)NODEREDTIME_TIMEOUT_MS);
+		return;
+
+	}
+
+	if (_srtt_ms <= 0.0) {
+
+		// first measurement
+		_srtt_ms = rtt_ms;
+		_rttvar_ms = rtt_ms / 2.0;
+
+	} else {
+
+		// RFC 6298 weights (beta = 1/4, alpha = 1/8)
+		_rttvar_ms = 0.75 * _rttvar_ms + 0.25 * fabs(_srtt_ms - rtt_ms);
+		_srtt_ms = 0.875 * _srtt_ms + 0.125 * rtt_ms;
+
+	}
+
+	double timeout_ms = _srtt_ms + 4.0 * _rttvar_ms;
+
+	_timeout_ms = min(
+		max(timeout_ms, (double)NODEREDTIME_TIMEOUT_MIN_MS),
+		(double)NODEREDTIME_TIMEOUT_MS
+	);
+
+}
+
+
+bool NodeRedTime::consumeReply(char c) {
+
+	// body is kept as-is (a number, so any excess is truncated)
+	if (_replyState == REPLY_BODY) {
+
+		if (_lineLength < sizeof(_line) - 1) {
+			_line[_lineLength++] = c;
+		}
+
+		_bodyLength++;
+
+		return true;
+
+	}
+
+	// status line and headers are processed a line at a time
+	if (c != '\n') {
+
+		if (c != '\r' && _lineLength < sizeof(_line) - 1) {
+			_line[_lineLength++] = c;
+		}
+
+		return true;
+
+	}
+
+	_line[_lineLength] = '\0';
+
+	if (_replyState == REPLY_STATUS) {
+
+		// expecting "HTTP/1.x 200 OK" (or 503 if the server is shedding load)
+		const char * code = strchr(_line, ' ');
+		_replyStatus = code ? atoi(code) : 0;
+		if (_replyStatus != 200 && _replyStatus != 503) {
+			return false;
+		}
+
+		_replyState = REPLY_HEADERS;
+
+	} else if (_lineLength == 0) {
+
+		// a blank line separates the headers from the body
+		_replyState = REPLY_BODY;
+
+	} else if (strncasecmp(_line, "Content-Length:", 15) == 0) {
+
+		_contentLength = atol(_line + 15);
+
+	} else if (strncasecmp(_line, "Retry-After:", 12) == 0) {
+
+		// delta-seconds form only (an HTTP-date parses as zero)
+		_retryAfter_s = atol(_line + 12);
+
+	} else if (strncasecmp(_line, "Leap-Seconds:", 13) == 0) {
+
+		// "37" (TAI-UTC now) or "38@1861920000" (from that Unix time)
+		_replyLeap_s = atoi(_line + 13);
+		const char * at = strchr(_line, '@');
+		_replyLeapEffective_s = at ? atol(at + 1) : 0;
+
+	}
 
-    // syntheticTime() can't answer - ask Node-Red
-	return serverTime(epoch);
+	_lineLength = 0;
+	return true;
 
 }
@@ -10,13 +10,117 @@
 #include <time.h>
 
 
-#if (ESP32)
-#include <HTTPClient.h>
+#include <WiFiClient.h>
+#include <WiFiClientSecure.h>
+#include <WiFiUdp.h>
+
+/// @brief ceiling on the connect and response timeouts (milliseconds).
+/// Also the timeout used before any round trip has been measured. Same as
+/// the HTTPClient default.
+#ifndef NODEREDTIME_TIMEOUT_MS
+#define NODEREDTIME_TIMEOUT_MS 5000
 #endif
 
-#if (ESP8266)
-#include <WiFiClient.h>
-#include <ESP8266HTTPClient.h>
+/// @brief floor on the connect and response timeouts (milliseconds). Stops
+/// a run of very fast replies on a quiet LAN from producing a timeout which
+/// would be tripped by ordinary scheduling jitter on the server.
+#ifndef NODEREDTIME_TIMEOUT_MIN_MS
+#define NODEREDTIME_TIMEOUT_MIN_MS 50
+#endif
+
+/// @brief first 4-byte block of ESP8266 RTC user memory used by NodeRedTime
+/// to carry state across deep sleep (the TLS session for https URLs, then
+/// the sleep-timer calibration). The default leaves blocks 0..63 (the
+/// first 256 bytes) to the sketch.
+#ifndef NODEREDTIME_RTC_OFFSET
+#define NODEREDTIME_RTC_OFFSET 64
+#endif
+
+/// @brief number of sleep-timer calibration samples (see
+/// NodeRedTime::calibratedSleep_us()) needed before syntheticTime() will
+/// trust its prediction of the time after waking from deep sleep.
+#ifndef NODEREDTIME_SLEEP_SAMPLES
+#define NODEREDTIME_SLEEP_SAMPLES 3
+#endif
+
+/// @brief set to 1 to record free heap, largest free block and stack
+/// high-water mark around every synchronisation (see NodeRedTime::Stats).
+/// Off by default because the ESP8266 heap queries walk the free list.
+#ifndef NODEREDTIME_HEAP_STATS
+#define NODEREDTIME_HEAP_STATS 0
+#endif
+
+/// @brief size of the buffer used to hold one line of the server's reply.
+/// Anything beyond this on a single line is discarded, which is harmless
+/// for headers (only Content-Length is examined). The body is a 13-digit
+/// integer.
+#ifndef NODEREDTIME_LINE_SIZE
+#define NODEREDTIME_LINE_SIZE 32
+#endif
+
+/// @brief size of the buffer in which the HTTP request is built (on the
+/// stack, once per synchronisation). Fits the request line, the Host
+/// header and a path and host name of up to about 40 characters each. A
+/// longer URL makes every synchronisation fail.
+#ifndef NODEREDTIME_REQUEST_SIZE
+#define NODEREDTIME_REQUEST_SIZE 128
+#endif
+
+/// @brief number of times a confirmable CoAP request is retransmitted
+/// before the synchronisation fails (RFC 7252 MAX_RETRANSMIT).
+#ifndef NODEREDTIME_COAP_RETRANSMIT
+#define NODEREDTIME_COAP_RETRANSMIT 4
+#endif
+
+/// @brief size of the buffers holding a CoAP request and reply. The
+/// request is 8 bytes plus the path; the reply a few bytes plus the
+/// 13-digit payload.
+#ifndef NODEREDTIME_COAP_SIZE
+#define NODEREDTIME_COAP_SIZE 64
+#endif
+
+/// @brief back-off (seconds) after a 503 (HTTP) or 5.03 (CoAP) reply which
+/// does not say how long to stay away.
+#ifndef NODEREDTIME_RETRY_AFTER_S
+#define NODEREDTIME_RETRY_AFTER_S 60
+#endif
+
+/// @brief ceiling (seconds) on the back-off requested by a server.
+#ifndef NODEREDTIME_RETRY_AFTER_MAX_S
+#define NODEREDTIME_RETRY_AFTER_MAX_S 3600
+#endif
+
+/// @brief worst-case frequency error (parts per million) assumed for the
+/// crystal behind millis() when growing a source's error bound (see
+/// NodeRedTime::errorBound_ms()).
+#ifndef NODEREDTIME_DRIFT_PPM
+#define NODEREDTIME_DRIFT_PPM 50
+#endif
+
+/// @brief error (parts per million) assumed for a calibrated prediction of
+/// the time spent in deep sleep (see NodeRedTime::calibratedSleep_us()).
+#ifndef NODEREDTIME_SLEEP_DRIFT_PPM
+#define NODEREDTIME_SLEEP_DRIFT_PPM 1000
+#endif
+
+/// @brief error (milliseconds) assumed for the platform SNTP client just
+/// after it synchronises. The lwIP client does not report one.
+#ifndef NODEREDTIME_SNTP_ERROR_MS
+#define NODEREDTIME_SNTP_ERROR_MS 50
+#endif
+
+/// @brief furthest (milliseconds) a timestamp passed to
+/// NodeRedTime::hlcReceive() may be ahead of this device's synthetic time.
+/// Anything further is taken to come from a peer with a wrong (or corrupt)
+/// clock and is not merged.
+#ifndef NODEREDTIME_HLC_MAX_OFFSET_MS
+#define NODEREDTIME_HLC_MAX_OFFSET_MS 60000
+#endif
+
+/// @brief after Node-Red fails while SNTP is available, how long (seconds)
+/// syntheticTime() serves SNTP time before asking Node-Red again.
+#ifndef NODEREDTIME_FAILOVER_RETRY_S
+#define NODEREDTIME_FAILOVER_RETRY_S 60
 #endif
 
 /*!	@brief Class to obtain Unix epoch time values from a Node-Red server.
@@ -32,6 +136,67 @@ class NodeRedTime {
 
     public:
 
+		/*!	@brief Progress of a non-blocking synchronisation started by beginSync().
+		**
+		**	- SYNC_IDLE no synchronisation in progress.
+		**	- SYNC_PENDING request sent, reply not yet complete.
+		**	- SYNC_SUCCEEDED a valid time value was obtained.
+		**	- SYNC_FAILED no valid time value could be obtained.
+		*/
+		enum SyncStatus {
+			SYNC_IDLE,
+			SYNC_PENDING,
+			SYNC_SUCCEEDED,
+			SYNC_FAILED
+		};
+
+		/*!	@brief Where a synthetic time came from (see useSntp()).
+		**
+		**	- SOURCE_NONE no time was available.
+		**	- SOURCE_NODERED extrapolated from the last Node-Red synchronisation.
+		**	- SOURCE_SNTP the system clock, as set by the platform's SNTP client.
+		*/
+		enum TimeSource {
+			SOURCE_NONE,
+			SOURCE_NODERED,
+			SOURCE_SNTP
+		};
+
+		/*!	@brief Counters and measurements returned by stats().
+		**
+		**	The heap and stack members are only maintained when the library is
+		**	compiled with NODEREDTIME_HEAP_STATS set to 1, and are zero otherwise.
+		**	"Before" is sampled as a synchronisation starts (serverTime() or
+		**	beginSync()) and "after" as it completes. A free heap which keeps
+		**	falling, or a largest free block which shrinks while free heap holds
+		**	steady (fragmentation), points at the synchronisation traffic.
+		*/
+		struct Stats {
+			unsigned long syncAttempts = 0;		///< synchronisations started
+			unsigned long syncFailures = 0;		///< synchronisations which did not yield a valid time
+			double srtt_ms = 0.0;				///< smoothed round-trip time
+			double rttvar_ms = 0.0;				///< round-trip time variance
+			unsigned long timeout_ms = 0;		///< current connect and response timeout
+			uint32_t heapBefore = 0;			///< free heap as the last synchronisation started
+			uint32_t heapAfter = 0;				///< free heap as the last synchronisation completed
+			uint32_t heapLowest = 0;			///< lowest free heap seen at either point
+			uint32_t blockBefore = 0;			///< largest free block as the last synchronisation started
+			uint32_t blockAfter = 0;			///< largest free block as the last synchronisation completed
+			uint32_t blockLowest = 0;			///< smallest largest-free-block seen at either point
+			uint32_t stackHighWater = 0;		///< least free stack ever seen (bytes)
+			double budgetSyncs = 0.0;			///< synchronisations charged to the rolling window
+			double budgetNetwork_ms = 0.0;		///< network time charged to the rolling window
+			unsigned long budgetDenials = 0;	///< synchronisations refused by the budget
+			unsigned long coapRetransmits = 0;	///< confirmable CoAP requests sent again
+			unsigned long serverBackoffs = 0;	///< 503 (or CoAP 5.03) replies received
+			unsigned long backoffDenials = 0;	///< synchronisations skipped while backing off
+			unsigned long sntpSyncs = 0;		///< SNTP synchronisations seen (all objects)
+			unsigned long sntpSelections = 0;	///< synthetic times taken from SNTP
+			unsigned long failovers = 0;		///< Node-Red failures covered by SNTP
+			unsigned long hlcRejects = 0;		///< remote HLC timestamps too far ahead to merge
+		};
+
+
 		/*!	@brief NodeRedTime constructor
 		**
 		**	Sample code:
@@ -41,7 +206,9 @@ class NodeRedTime {
 		**	@endcode
 		**
 		**	@param [in] url well-formed Node-Red URL
-		**	(eg "http://host.domain.com:1880:/time/").
+		**	(eg "http://host.domain.com:1880:/time/"). An "https" URL selects TLS
+		**	(see setRootCA()). A "coap" URL (eg "coap://host.domain.com/time")
+		**	selects CoAP over UDP (see setConfirmable()).
 		**
 		**	@param [in] recall_s the number of seconds between enforced calls to
 		**	serverTime() within syntheticTime(). Defaults to 1 hour. Any value passed
@@ -71,6 +238,11 @@ class NodeRedTime {
 		**	string representation of a positive integer of the number of whole milliseconds
 		**	that have elepsed since the Unix epoch on 1970-01-01T00:00:00.000Z.
 		**
+		**	This is beginSync() followed by pollSync() until the reply is complete. The
+		**	request is the smallest valid HTTP/1.1 request (a request line and a Host
+		**	header) and only the status line and Content-Length header of the reply are
+		**	examined. The body is read into a fixed buffer, so no String is allocated.
+		**
 		**	Sample code:
 		**	@code{.cpp}
 		**	time_t epochTime;
@@ -87,12 +259,26 @@ class NodeRedTime {
 		**
 		**	@param [out] epoch pointer to time_t, must not be nil.
 		**
-		**	@return **true** if a valid time value was able to be obtained from Node-Red.
-		**	Otherwise **false**.
+		**	@return **true** if a valid time value was able to be obtained from Node-Red
+		**	(or, when the budget set by setSyncBudget() is exhausted or the server has
+		**	asked for a back-off, extrapolated from the last synchronisation). Otherwise
+		**	**false**.
+		**
+		**	@remark A server which is shedding load may reply "503 Service Unavailable"
+		**	with a Retry-After header (CoAP: 5.03 with Max-Age). No request is then sent
+		**	until that many seconds (NODEREDTIME_RETRY_AFTER_S if not given, at most
+		**	NODEREDTIME_RETRY_AFTER_MAX_S) plus up to 25% jitter have passed. The last
+		**	synchronisation is kept, so time is still served throughout:
+		**	@code{.cpp}
+		**	time_t epoch;
+		**	nodeRedTime.serverTime(&epoch);		// synchronises
+		**	...
+		**	nodeRedTime.serverTime(&epoch);		// 503 Retry-After: 600 - true, extrapolated
+		**	nodeRedTime.syntheticTime(&epoch);	// true, extrapolated, nothing sent
+		**	@endcode
 		**
 		**	@remark time_t is declared "typedef uint32_t time_t" (an unsigned 32-bit quantity).
-		**	The Node-Red response is interpreted by HTTPClient::getString().toDouble()
-		**	which parses like this:
+		**	The Node-Red response body is interpreted by atof() which parses like this:
 		**	- Skips leading spaces.
 		**	- Handles leading "+" or "-" correctly (returns signed quantity).
 		**	- Stops parsing on the first non-numeric character or end-of-string.
@@ -136,13 +322,805 @@ class NodeRedTime {
 		bool syntheticTime(time_t * epoch) __attribute__((nonnull));
 
 
+		/*!	@brief Millisecond version of syntheticTime()
+		**
+		**	Same rules as syntheticTime() for when to call serverTime() but returns
+		**	whole epoch milliseconds.
+		**
+		**	@param [out] epoch_ms pointer to double, must not be nil. Unchanged if
+		**	the return value is **false**.
+		**
+		**	@return **true** if a time value could be synthesized or obtained.
+		**/
+		bool syntheticMillis(double * epoch_ms) __attribute__((nonnull));
+
+
+		/*!	@brief Synthetic time on the TAI scale, in milliseconds
+		**
+		**	UTC epoch values repeat a second at every leap second; International
+		**	Atomic Time (TAI) does not. Computed as syntheticMillis() plus TAI-UTC
+		**	(see taiOffset_s()), which is the same scale as Linux CLOCK_TAI:
+		**	milliseconds since 1970-01-01T00:00:00 TAI.
+		**
+		**	@param [out] tai_ms pointer to double, must not be nil. Unchanged if
+		**	the return value is **false**.
+		**
+		**	@return as for syntheticMillis().
+		**/
+		bool taiMillis(double * tai_ms) __attribute__((nonnull));
+
+
+		/*!	@brief Synthetic time on the GPS scale, in milliseconds
+		**
+		**	Milliseconds since the GPS epoch (1980-01-06T00:00:00 UTC) without leap
+		**	seconds, ie TAI minus 19 seconds, counted from that epoch. Divide by
+		**	604800000 for the GPS week.
+		**
+		**	@param [out] gps_ms pointer to double, must not be nil. Unchanged if
+		**	the return value is **false**.
+		**
+		**	@return as for syntheticMillis().
+		**/
+		bool gpsMillis(double * gps_ms) __attribute__((nonnull));
+
+
+		/*!	@brief TAI-UTC (seconds) in effect at a UTC instant
+		**
+		**	Looked up in the built-in leap-second table (1972-01-01 onwards, 37s
+		**	since 2017-01-01) unless the server has announced a later change (see
+		**	setLeapSeconds()). Earlier instants get the 1972 value (10s).
+		**
+		**	@param [in] utc_ms Unix epoch milliseconds.
+		**
+		**	@return TAI-UTC in whole seconds.
+		**/
+		int taiOffset_s(double utc_ms) const;
+
+
+		/*!	@brief Record a change of TAI-UTC not in the built-in table
+		**
+		**	Called automatically when a Node-Red reply carries a header of the form
+		**	"Leap-Seconds: 37" (TAI-UTC now) or "Leap-Seconds: 38@1861920000"
+		**	(TAI-UTC from that Unix time on, as announced in IERS Bulletin C).
+		**	Held in RAM only, so it is learned again after a restart.
+		**
+		**	@param [in] taiMinusUtc_s TAI-UTC in seconds.
+		**	@param [in] effective_s Unix time from which it applies.
+		**
+		**	@return nothing.
+		**/
+		void setLeapSeconds(int taiMinusUtc_s, time_t effective_s);
+
+
+		/*!	@brief Hybrid logical clock timestamp for a local or send event
+		**
+		**	Synthetic times from different devices can disagree by more than the gap
+		**	between related events. A hybrid logical clock (HLC) timestamp combines
+		**	synthetic physical time with a logical counter so that, provided every
+		**	message carries its sender's HLC timestamp and every receiver passes it
+		**	to hlcReceive(), an effect always has a later timestamp than its cause
+		**	while timestamps stay within the synchronisation error of real time.
+		**
+		**	A timestamp is a single uint64_t which compares and sorts directly:
+		**	- bits 63..16 epoch milliseconds (see hlcMillis()); and
+		**	- bits 15..0 logical counter (see hlcCounter()).
+		**
+		**	Timestamps from one NodeRedTime object are strictly increasing, even if
+		**	synchronisation steps the synthetic clock backwards.
+		**
+		**	Sample code:
+		**	@code{.cpp}
+		**	uint64_t stamp;
+		**	nodeRedTime.hlcNow(&stamp);
+		**	publish(reading, stamp);
+		**	@endcode
+		**
+		**	@param [out] hlc pointer to the timestamp, must not be nil.
+		**
+		**	@return **true** if synthetic time was available. If **false**, the
+		**	timestamp is still produced and ordered but only advanced logically.
+		**/
+		bool hlcNow(uint64_t * hlc) __attribute__((nonnull));
+
+
+		/*!	@brief Merge a hybrid logical clock timestamp received from a peer
+		**
+		**	Advances this device's HLC past both its own clock and the remote
+		**	timestamp, so anything this device does next is ordered after the
+		**	event which produced the remote timestamp.
+		**
+		**	A remote timestamp more than NODEREDTIME_HLC_MAX_OFFSET_MS ahead of
+		**	synthetic time would drag this device's HLC (and every later
+		**	timestamp) ahead with it for good, so it is not merged: the receive
+		**	event is stamped as a local event and stats().hlcRejects is counted.
+		**
+		**	@param [in] remote the timestamp carried by the received message.
+		**	@param [out] hlc pointer to the timestamp of the receive event, must not
+		**	be nil.
+		**
+		**	@return as for hlcNow(), and **false** if the remote timestamp was
+		**	rejected.
+		**/
+		bool hlcReceive(uint64_t remote, uint64_t * hlc) __attribute__((nonnull));
+
+
+		/*!	@brief Count of changes to the synchronisation point
+		**
+		**	Incremented whenever a synchronisation succeeds or a prediction is
+		**	restored after deep sleep. Anything derived from synthetic time (eg a
+		**	NodeRedTimeScheduler's fire times) can compare this with the value it
+		**	last saw to know when to recompute.
+		**
+		**	@return the count.
+		**/
+		uint32_t syncGeneration() const { return _syncGeneration; }
+
+
+		/// @brief epoch milliseconds part of an HLC timestamp.
+		static uint64_t hlcMillis(uint64_t hlc) { return hlc >> 16; }
+
+		/// @brief logical counter part of an HLC timestamp.
+		static uint16_t hlcCounter(uint64_t hlc) { return hlc & 0xFFFF; }
+
+
+		/*!	@brief Start a non-blocking request for the time from Node-Red
+		**
+		**	Connects to the Node-Red server and sends the request, then returns
+		**	without waiting for the reply. The reply is collected by calling
+		**	pollSync() until it returns something other than SYNC_PENDING. This
+		**	lets a sketch get on with other work (eg reading sensors) while the
+		**	request is in flight, instead of blocking inside serverTime().
+		**
+		**	Sample code:
+		**	@code{.cpp}
+		**	if (nodeRedTime.beginSync()) {
+		**		readSensors();
+		**		time_t epochTime;
+		**		NodeRedTime::SyncStatus status;
+		**		while ((status = nodeRedTime.pollSync(&epochTime)) == NodeRedTime::SYNC_PENDING) {
+		**			delay(1);
+		**		}
+		**		if (status == NodeRedTime::SYNC_SUCCEEDED) {
+		**			Serial.printf("epoch: %lu\n",epochTime);
+		**		}
+		**	}
+		**	@endcode
+		**
+		**	@remark Establishing the TCP connection is still a blocking operation
+		**	(that is the way WiFiClient::connect() works on both ESP8266 and ESP32)
+		**	but it is only a small part of the round trip on a local area network.
+		**	Waiting for Node-Red to reply is the part which is overlapped.
+		**
+		**	@remark Any synchronisation which is already in progress is abandoned.
+		**
+		**	@return **true** if the request was sent. **false** if the server could
+		**	not be reached, in which case pollSync() will return SYNC_IDLE.
+		**/
+		bool beginSync();
+
+
+		/*!	@brief Open the connection to Node-Red ahead of time
+		**
+		**	Resolves the server name (once - the address is cached) and opens the
+		**	TCP connection as soon as the WiFi interface has an IP address, so the
+		**	next serverTime() or beginSync() sends its request immediately instead
+		**	of starting DNS and the TCP handshake from scratch. Intended to be called
+		**	from the loop which waits for WL_CONNECTED after waking, so connection
+		**	setup overlaps with the rest of the sketch's initialisation.
+		**
+		**	Sample code:
+		**	@code{.cpp}
+		**	WiFi.begin(ssid,password);
+		**	while (WiFi.status() != WL_CONNECTED) {
+		**		delay(50);
+		**	}
+		**	nodeRedTime.prepare();
+		**	initialiseSensors();
+		**	time_t epochTime;
+		**	nodeRedTime.serverTime(&epochTime);
+		**	@endcode
+		**
+		**	@remark Node-Red (like any HTTP server) closes idle connections after a
+		**	few seconds. A connection which has been closed by the server is
+		**	re-opened by the next request, so calling prepare() too early costs
+		**	nothing more than not calling it at all.
+		**
+		**	@return **true** if the connection is open. **false** if the interface
+		**	has no IP address yet, a synchronisation is in progress, or the server
+		**	could not be reached.
+		**/
+		bool prepare();
+
+
+		/*!	@brief Limit how much synchronisation may happen
+		**
+		**	Caps the number of synchronisations and/or the total network time they
+		**	consume within a rolling window. Both syntheticTime() and explicit calls
+		**	to serverTime() respect the budget: once it is exhausted, serverTime()
+		**	does not touch the network and instead returns time extrapolated from
+		**	the last synchronisation (if there has been one), while beginSync()
+		**	returns **false**. This protects battery life against a sketch which
+		**	calls serverTime() in a loop.
+		**
+		**	The rolling window is approximated from the current and previous fixed
+		**	windows, with the previous one weighted by how much of it still lies
+		**	inside the rolling window.
+		**
+		**	Sample code:
+		**	@code{.cpp}
+		**	// at most 30 synchronisations or 3 seconds of network time per day
+		**	nodeRedTime.setSyncBudget(30, 3000, 86400);
+		**	@endcode
+		**
+		**	@param [in] maxSyncs maximum synchronisations per window (0 = no limit).
+		**	@param [in] maxNetwork_ms maximum network milliseconds per window, from
+		**	connecting to receiving the reply (0 = no limit).
+		**	@param [in] window_s length of the window in seconds (0 = no budget).
+		**
+		**	@return nothing.
+		**/
+		void setSyncBudget(
+			unsigned int maxSyncs,
+			unsigned long maxNetwork_ms,
+			unsigned long window_s
+		);
+
+
+		/*!	@brief Deep-sleep duration corrected for the sleep timer's error
+		**
+		**	The deep-sleep timer runs from an RTC clock which can be several percent
+		**	fast or slow. NodeRedTime learns the ratio between the sleep requested
+		**	and the sleep which actually elapsed (as measured by the next successful
+		**	synchronisation) and uses it in two ways:
+		**	- the value returned here is the request which should produce
+		**	  desired_s of real time; and
+		**	- after waking, syntheticTime() predicts the time from the state saved
+		**	  here instead of asking Node-Red, provided the ratio has been learned
+		**	  from at least NODEREDTIME_SLEEP_SAMPLES sleeps and _recall_ms has not
+		**	  elapsed since the last real synchronisation.
+		**
+		**	The state is kept in RTC memory (on ESP8266, RTC user memory following
+		**	the TLS session at NODEREDTIME_RTC_OFFSET) and consumed on the first
+		**	call to syntheticTime(), serverTime() or beginSync() after waking, so a
+		**	sleep entered some other way is never mistaken for a calibrated one.
+		**
+		**	Sample code:
+		**	@code{.cpp}
+		**	ESP.deepSleep(nodeRedTime.calibratedSleep_us(60));
+		**	@endcode
+		**
+		**	@param [in] desired_s the real time the device should sleep for.
+		**
+		**	@return the duration (microseconds) to pass to ESP.deepSleep() or
+		**	esp_sleep_enable_timer_wakeup(). Call immediately before sleeping.
+		**/
+		uint64_t calibratedSleep_us(double desired_s);
+
+
+		/*!	@brief Trust anchor for an https URL
+		**
+		**	Supplies the PEM-encoded certificate of the root (or self-signed) CA
+		**	which signed the Node-Red server's certificate. Has no effect for http
+		**	URLs.
+		**
+		**	@param [in] rootCA PEM certificate. Must remain valid for the life of
+		**	the NodeRedTime object (typically a string literal).
+		**
+		**	@warning Until setRootCA() is called, https connections are encrypted
+		**	but the server's certificate is **not** verified.
+		**
+		**	@remark A full TLS handshake costs several times the round trip of a
+		**	plain request. On ESP8266, the TLS session is cached (in RAM, and in RTC
+		**	user memory at NODEREDTIME_RTC_OFFSET so it survives deep sleep) and
+		**	later connections resume it with an abbreviated handshake. The ESP32
+		**	WiFiClientSecure does not expose session resumption, so every https
+		**	connection on ESP32 performs a full handshake.
+		**
+		**	@return nothing.
+		**/
+		void setRootCA(const char * rootCA);
+
+
+		/*!	@brief Change the Node-Red server
+		**
+		**	Takes a URL of the same form as the constructor. Any synchronisation in
+		**	progress is abandoned, open connections are closed, and the cached
+		**	server address and round-trip estimate are discarded. The last
+		**	synchronisation (if any) remains valid, so syntheticTime() carries on
+		**	extrapolating until the recall period ends.
+		**
+		**	@param [in] url well-formed Node-Red URL.
+		**
+		**	@return nothing.
+		**/
+		void setServer(const char * url);
+
+
+		/// @brief the URL of the Node-Red server in use.
+		const String & url() const { return _url; }
+
+
+		/*!	@brief Use the platform's SNTP client as a second source
+		**
+		**	Registers for the platform's notification that SNTP has set the system
+		**	clock (settimeofday_cb() on ESP8266, sntp_set_time_sync_notification_cb()
+		**	on ESP32). From then on, syntheticTime() and syntheticMillis() compare
+		**	the error bound of each source (see errorBound_ms()) and return the
+		**	time from whichever is smaller. If Node-Red fails while SNTP time is
+		**	available, SNTP time is served and Node-Red is not asked again for
+		**	NODEREDTIME_FAILOVER_RETRY_S, so a sketch keeps good time while
+		**	Node-Red is down without any change.
+		**
+		**	The sketch still starts SNTP itself, eg:
+		**	@code{.cpp}
+		**	configTime(0, 0, "pool.ntp.org");
+		**	nodeRedTime.useSntp();
+		**	@endcode
+		**
+		**	@remark Only one notification callback can be registered. A sketch
+		**	which needs its own should call sntpSynchronised() from it.
+		**
+		**	@remark Switching source can step synthetic time by the difference
+		**	between the sources. hlcNow() and NodeRedTimeId stay monotonic.
+		**
+		**	@param [in] enable **false** to go back to Node-Red only.
+		**
+		**	@return nothing.
+		**/
+		void useSntp(bool enable = true);
+
+
+		/// @brief note that SNTP has just set the system clock (see useSntp()).
+		static void sntpSynchronised();
+
+
+		/*!	@brief Error bound of a source
+		**
+		**	- Node-Red: half the round-trip time of the request which synchronised,
+		**	  plus NODEREDTIME_DRIFT_PPM of the time since (and
+		**	  NODEREDTIME_SLEEP_DRIFT_PPM of any predicted deep sleep).
+		**	- SNTP: NODEREDTIME_SNTP_ERROR_MS plus NODEREDTIME_DRIFT_PPM of the time
+		**	  since SNTP last set the clock.
+		**
+		**	@param [in] source SOURCE_NODERED or SOURCE_SNTP.
+		**
+		**	@return the bound in milliseconds, or a negative value if the source
+		**	has no time to offer (never synchronised, recall period over, or SNTP
+		**	not enabled).
+		**/
+		double errorBound_ms(TimeSource source);
+
+
+		/// @brief the source of the last time returned by syntheticTime() or
+		/// syntheticMillis().
+		TimeSource lastSource() const { return _lastSource; }
+
+
+		#if (ESP8266)
+
+		/*!	@brief First free block of RTC user memory
+		**
+		**	NodeRedTime keeps its TLS session and sleep calibration in RTC user
+		**	memory from NODEREDTIME_RTC_OFFSET. Companion classes which need to
+		**	survive deep sleep keep their state from this block onwards.
+		**
+		**	@return a 4-byte block number for ESP.rtcUserMemoryRead()/Write().
+		**/
+		static uint32_t rtcFreeBlock();
+
+		#endif
+
+
+		/*!	@brief Confirmable or non-confirmable CoAP requests
+		**
+		**	Has no effect unless the URL is a "coap" URL. The request is a single
+		**	GET datagram carrying the path as Uri-Path options, and the reply a
+		**	single datagram whose payload is the epoch milliseconds value.
+		**
+		**	- Confirmable (the default): if no reply arrives within the timeout
+		**	  derived from the measured round-trip time (plus up to 50% random
+		**	  jitter, as RFC 7252 recommends) the request is sent again with the
+		**	  timeout doubled, up to NODEREDTIME_COAP_RETRANSMIT times. Round trips
+		**	  of retransmitted requests are ambiguous and are not measured. A
+		**	  server which acknowledges first and answers later (a "separate"
+		**	  response) is also handled.
+		**	- Non-confirmable: the request is sent once and the synchronisation
+		**	  fails if no reply arrives within the timeout, which then backs off
+		**	  as it does for http. Cheapest on air, suited to being called again
+		**	  on the next syntheticTime() recall anyway.
+		**
+		**	@param [in] confirmable **true** for confirmable requests.
+		**
+		**	@return nothing.
+		**/
+		void setConfirmable(bool confirmable) { _confirmable = confirmable; }
+
+
+		/*!	@brief Synchronisation statistics
+		**
+		**	Sample code:
+		**	@code{.cpp}
+		**	const NodeRedTime::Stats & stats = nodeRedTime.stats();
+		**	Serial.printf("heap %u -> %u, largest block %u -> %u\n",
+		**		stats.heapBefore, stats.heapAfter,
+		**		stats.blockBefore, stats.blockAfter);
+		**	@endcode
+		**
+		**	@return reference to the statistics (updated in place by later calls).
+		**/
+		const Stats & stats();
+
+
+		/*!	@brief Make progress on a synchronisation started by beginSync()
+		**
+		**	Consumes whatever part of the server's reply has arrived, without
+		**	waiting for more. When the reply is complete, the result is treated
+		**	exactly as if it had come from serverTime() (ie a valid reply resets
+		**	the point from which syntheticTime() extrapolates).
+		**
+		**	@param [out] epoch pointer to time_t, must not be nil. Only written
+		**	when the return value is SYNC_SUCCEEDED (the time value) or
+		**	SYNC_FAILED (zero).
+		**
+		**	@return SYNC_PENDING while the reply is still outstanding. Returns
+		**	SYNC_SUCCEEDED or SYNC_FAILED exactly once when the synchronisation
+		**	completes (including by timing out - see updateRoundTrip()), after
+		**	which the state reverts to SYNC_IDLE.
+		**/
+		SyncStatus pollSync(time_t * epoch) __attribute__((nonnull));
+
+
     protected:
 
+		/*!	@brief Accept (or reject) a value obtained from Node-Red
+		**
+		**	Common tail of serverTime() and pollSync(). Updates the synchronisation
+		**	point if serverTime_ms is valid. Otherwise the last synchronisation
+		**	point (if any) is kept, and goes on being used until it leaves the
+		**	recall period.
+		**
+		**	@param [in] serverTime_ms the server's reply (zero if none).
+		**	@param [in] sync_ms the millis() value at the estimated moment the
+		**	server read its clock.
+		**	@param [out] epoch pointer to time_t, must not be nil.
+		**
+		**	@return **true** if serverTime_ms was a valid time value.
+		**/
+		bool acceptServerTime(
+			double serverTime_ms,
+			unsigned long sync_ms,
+			time_t * epoch
+		) __attribute__((nonnull));
+
+
+		/*!	@brief Accept (or reject) a sample measured without beginSync()
+		**
+		**	For a subclass which obtains server time some other way (eg a
+		**	simulation). Records the round trip, as beginSync() and pollSync()
+		**	would, so the error bound reflects this sample, then calls
+		**	acceptServerTime() with its mid-point.
+		**
+		**	@param [in] serverTime_ms the server's reply (zero if none).
+		**	@param [in] sent_ms the millis() value when the request was sent.
+		**	@param [in] received_ms the millis() value when the reply arrived.
+		**	@param [out] epoch pointer to time_t, must not be nil.
+		**
+		**	@return **true** if serverTime_ms was a valid time value.
+		**/
+		bool acceptSample(
+			double serverTime_ms,
+			unsigned long sent_ms,
+			unsigned long received_ms,
+			time_t * epoch
+		) __attribute__((nonnull));
+
+		/*!	@brief Connect _client to the Node-Red server
+		**
+		**	Uses the cached server address when there is one, otherwise resolves
+		**	_host and caches the result. A failed connection discards the cached
+		**	address so the name is resolved again next time.
+		**
+		**	@return **true** if the connection is open.
+		**/
+		bool connectToServer();
+
+		/*!	@brief TLS counterpart of connectToServer(). Connects by name so the
+		**	server name is available for SNI and certificate verification.
+		**
+		**	@return **true** if the connection is open.
+		**/
+		bool connectSecure();
+
+		#if (ESP8266)
+
+		/// @brief copy the TLS session to RTC user memory.
+		void saveSession();
+
+		/// @brief recover the TLS session from RTC user memory (if valid).
+		void restoreSession();
+
+		#endif
+
+		#if (NODEREDTIME_HEAP_STATS)
+
+		/// @brief sample heap (and, after, stack) into _stats.
+		void recordHeap(bool after);
+
+		#endif
+
+		/// @brief the HLC timestamp which follows hlc given physical time
+		/// physical_ms.
+		static uint64_t hlcAdvance(uint64_t hlc, double physical_ms);
+
+		/// @brief common bookkeeping when a synchronisation started by beginSync()
+		/// completes: failure count, budget charge and heap sample.
+		void syncFinished(bool valid);
+
+		/// @brief true unless a budget set by setSyncBudget() is exhausted.
+		bool budgetAvailable();
+
+		/// @brief true unless over budget or backing off after a 503. Counts
+		/// the denial.
+		bool syncAllowed();
+
+		/// @brief start backing off for retryAfter_s (plus jitter), as asked
+		/// by a 503 reply.
+		void serverBusy(unsigned long retryAfter_s);
+
+		/// @brief finish a synchronisation turned away by a 503 (or 5.03)
+		/// without disturbing the last synchronisation point.
+		SyncStatus syncRefused(time_t * epoch);
+
+		/// @brief time extrapolated from the last synchronisation, for when
+		/// no request may be sent (false if there is none to extrapolate).
+		bool extrapolatedTime(time_t * epoch);
+
+		/// @brief move to a new budget window if the current one has ended.
+		void rollBudgetWindow();
+
+		/// @brief true while SNTP is covering for a recent Node-Red failure.
+		bool failoverHolding();
+
+		/// @brief error bound of the last Node-Red synchronisation at now_ms,
+		/// whether or not it is still within the recall period.
+		double syncErrorBound_ms(double now_ms);
+
+		/// @brief the system clock in epoch milliseconds.
+		static double sntpMillis();
+
+		/// @brief weight of the previous window in the rolling window (0..1).
+		double budgetWeight();
+
+		/*!	@brief Recover the state saved by calibratedSleep_us() (once per boot)
+		**
+		**	Restores the calibration and, if it can be trusted, a predicted
+		**	synchronisation point. Invalidates the saved copy.
+		**/
+		void restoreSleep();
+
+		/*!	@brief Fold a measured round-trip time into the timeout estimate
+		**
+		**	Keeps a smoothed round-trip time and round-trip variance the way TCP
+		**	does (RFC 6298) and derives the timeout from them:
+		**
+		**		timeout = SRTT + 4 * RTTVAR
+		**
+		**	clipped to NODEREDTIME_TIMEOUT_MIN_MS..NODEREDTIME_TIMEOUT_MS. Both
+		**	the connect timeout and the response timeout use this value, so an
+		**	unreachable server is abandoned after a few typical round trips
+		**	rather than after the HTTPClient default of 5 seconds.
+		**
+		**	@param [in] rtt_ms round-trip time of a successful request, or a
+		**	negative value if the request timed out. A timeout doubles the
+		**	current timeout (up to the ceiling), as TCP does, so a congested
+		**	link is not abandoned repeatedly on the basis of stale samples.
+		**/
+		void updateRoundTrip(double rtt_ms);
+
+		/*!	@brief Check whether syntheticTime() may still extrapolate
+		**
+		**	@param [in] now_ms the current millis() value.
+		**
+		**	@return **true** if millis() has not wrapped and _recall_ms has not
+		**	elapsed since the last synchronisation.
+		**/
+		bool withinRecall(double now_ms);
+
+		/*!	@brief Convert a millis() value to epoch milliseconds
+		**
+		**	@pre _epochLastSync_ms is valid.
+		**
+		**	@param [in] uptime_ms a millis() value.
+		**
+		**	@return the epoch time in milliseconds corresponding to uptime_ms,
+		**	extrapolated from the last synchronisation.
+		**/
+		double uptimeToEpoch_ms(double uptime_ms);
+
+		/*!	@brief Feed one character of the server's reply to the parser used
+		**	by pollSync().
+		**
+		**	@return **false** if the reply can already be seen to be unusable
+		**	(eg the status code is not 200).
+		**/
+		bool consumeReply(char c);
+
+		/// @brief resolve the server name (if not cached) and open the UDP socket.
+		bool openCoap();
+
+		/// @brief CoAP counterpart of the request part of beginSync().
+		bool beginCoap();
+
+		/// @brief send (or re-send) the request in _coapRequest.
+		bool sendCoap();
+
+		/// @brief CoAP counterpart of pollSync().
+		SyncStatus pollCoap(time_t * epoch) __attribute__((nonnull));
+
+		/// @brief what a received datagram means to pollCoap().
+		enum CoapOutcome {
+			COAP_IGNORE,		///< not a reply to the current request
+			COAP_ACKNOWLEDGED,	///< empty ACK - a separate response will follow
+			COAP_RESPONSE,		///< the reply (its payload, if any, is in _line)
+			COAP_BUSY			///< 5.03 - serverBusy() has started the back-off
+		};
+
+		/*!	@brief Interpret a datagram received while a CoAP request is pending
+		**
+		**	@param [in] packet the datagram.
+		**	@param [in] length its length.
+		**	@param [out] ok **true** if a COAP_RESPONSE is 2.05 Content.
+		**
+		**	@return what the datagram means.
+		**/
+		CoapOutcome parseCoap(const uint8_t * packet, size_t length, bool * ok) __attribute__((nonnull));
+
+		/// @brief states of the reply parser used by pollSync().
+		enum ReplyState {
+			REPLY_STATUS,
+			REPLY_HEADERS,
+			REPLY_BODY
+		};
+
         ///	@brief url of Node-Red server. 
 		/// eg http://host.domain.com:1880:/time/
 		/// Initialized by constructor.
 		String _url;
 
+		/// @brief host, port and path components of _url.
+		/// Initialized by constructor. Used by beginSync().
+		String _host;
+		uint16_t _port = 80;
+		String _path;
+
+		/// @brief true if _url is an https URL. Initialized by constructor.
+		bool _secure = false;
+
+		/// @brief true if _url is a coap URL. Initialized by constructor.
+		bool _coap = false;
+
+		/// @brief confirmable or non-confirmable CoAP requests (see
+		/// setConfirmable()).
+		bool _confirmable = true;
+
+		/// @brief socket used for CoAP, and whether it has been opened.
+		WiFiUDP _udp;
+		bool _udpOpen = false;
+
+		/// @brief the pending CoAP request, its message ID and token.
+		uint8_t _coapRequest[NODEREDTIME_COAP_SIZE];
+		size_t _coapRequestLength = 0;
+		uint16_t _coapMessageId = 0;
+		uint32_t _coapToken = 0;
+
+		/// @brief transmissions of the pending request so far, and how long to
+		/// wait for a reply to the latest.
+		unsigned int _coapTransmissions = 0;
+		unsigned long _coapWait_ms = 0;
+
+		/// @brief true once the server has sent an empty ACK (a separate
+		/// response will follow), and millis() when it arrived.
+		bool _coapAcknowledged = false;
+		unsigned long _coapAck_ms = 0;
+
+		/// @brief the two kinds of connection. _client points to the one
+		/// which matches _url. Used by beginSync() and pollSync(). May be
+		/// opened in advance by prepare().
+		WiFiClient _plainClient;
+		WiFiClientSecure _secureClient;
+		WiFiClient * _client = &_plainClient;
+
+		#if (ESP8266)
+
+		/// @brief trust anchor set by setRootCA() (nullptr if none).
+		BearSSL::X509List * _trustAnchors = nullptr;
+
+		/// @brief TLS session reused by successive https connections, and
+		/// whether it has been recovered from RTC memory yet.
+		BearSSL::Session _session;
+		bool _sessionRestored = false;
+
+		#endif
+
+		#if (ESP32)
+
+		/// @brief trust anchor set by setRootCA() (nullptr if none).
+		const char * _rootCA = nullptr;
+
+		#endif
+
+		/// @brief cached address of _host, valid if _serverIPValid.
+		IPAddress _serverIP;
+		bool _serverIPValid = false;
+
+		/// @brief progress of a synchronisation started by beginSync().
+		SyncStatus _syncStatus = SYNC_IDLE;
+
+		/// @brief millis() when beginSync() started (before connecting). Used to
+		/// charge network time to the budget.
+		unsigned long _syncBegin_ms = 0;
+
+		/// @brief millis() when beginSync() sent its request, and when the
+		/// first byte of the reply arrived. The mid-point is the estimated
+		/// moment the server read its clock.
+		unsigned long _syncStart_ms = 0;
+		unsigned long _syncReply_ms = 0;
+
+		/// @brief smoothed round-trip time and round-trip variance
+		/// (milliseconds). Zero until the first successful request.
+		double _srtt_ms = 0.0;
+		double _rttvar_ms = 0.0;
+
+		/// @brief current connect and response timeout (milliseconds),
+		/// maintained by updateRoundTrip().
+		unsigned long _timeout_ms = NODEREDTIME_TIMEOUT_MS;
+
+		/// @brief returned by stats(). The round-trip members are copied in
+		/// when stats() is called.
+		Stats _stats;
+
+		/// @brief reply parser state, current line and its length.
+		ReplyState _replyState = REPLY_STATUS;
+		char _line[NODEREDTIME_LINE_SIZE];
+		size_t _lineLength = 0;
+
+		/// @brief status code of the reply, and its Retry-After header
+		/// (seconds, zero if not seen).
+		int _replyStatus = 0;
+		unsigned long _retryAfter_s = 0;
+
+		/// @brief Leap-Seconds header of the reply (TAI-UTC, zero if not seen) and
+		/// when it applies from (zero meaning the time in the reply).
+		int _replyLeap_s = 0;
+		time_t _replyLeapEffective_s = 0;
+
+		/// @brief set by setLeapSeconds(): TAI-UTC (zero if none) from
+		/// _leapEffective_s on.
+		int _leapOffset_s = 0;
+		time_t _leapEffective_s = 0;
+
+		/// @brief true while backing off after a 503 reply: from millis()
+		/// _backoffStart_ms for _backoff_ms.
+		bool _backoff = false;
+		unsigned long _backoffStart_ms = 0;
+		unsigned long _backoff_ms = 0;
+
+		/// @brief true if useSntp() has enabled SNTP as a second source.
+		bool _useSntp = false;
+
+		/// @brief true while serving SNTP time after Node-Red failed at
+		/// millis() _failoverStart_ms.
+		bool _failover = false;
+		unsigned long _failoverStart_ms = 0;
+
+		/// @brief returned by lastSource().
+		TimeSource _lastSource = SOURCE_NONE;
+
+		/// @brief Content-Length of the reply (-1 if not seen) and the
+		/// number of body bytes received so far.
+		long _contentLength = -1;
+		size_t _bodyLength = 0;
+
 		///	@brief the maximum time in milliseconds that  syntheticTime() can
 		///	calculate updated epoch values by adding elapsed time derived from
 		///	millis() to  _epochLastSync_ms. Once this period has expired, the next
@@ -170,6 +1148,47 @@ class NodeRedTime {
 		/// serverTime() but will only be non-zero if _epochLastSync_ms is also non-zero.
 		/// Used by syntheticTime(). Initialized to zero (implying millis() at system boot)
 		///	but zero can potentially be a valid value when millis() wraps (every 49.7 days).
+		/// Negative after a calibrated deep sleep: the synchronisation happened before
+		/// this boot, and the magnitude is the predicted time since then.
 		double _uptimeLastSync_ms = 0.0;
 
+		/// @brief error bound of _epochLastSync_ms when it was obtained (half the
+		/// round trip) and of any prediction across deep sleep since.
+		double _syncError_ms = 0.0;
+		double _sleepError_ms = 0.0;
+
+		/// @brief returned by syncGeneration().
+		uint32_t _syncGeneration = 0;
+
+		/// @brief the latest hybrid logical clock timestamp issued.
+		uint64_t _hlc = 0;
+
+		/// @brief budget set by setSyncBudget() (zero window = no budget).
+		unsigned int _budgetSyncs = 0;
+		unsigned long _budgetNetwork_ms = 0;
+		unsigned long _budgetWindow_ms = 0;
+
+		/// @brief start of the current fixed budget window, and the syncs and
+		/// network time charged to the current [0] and previous [1] windows.
+		unsigned long _windowStart_ms = 0;
+		double _windowSyncs[2] = { 0.0, 0.0 };
+		double _windowNetwork_ms[2] = { 0.0, 0.0 };
+
+		/// @brief learned ratio of actual to requested deep-sleep duration and the
+		/// number of sleeps it has been learned from.
+		double _sleepRatio = 1.0;
+		uint32_t _sleepSamples = 0;
+
+		/// @brief the chain of wakes and sleeps since the last real synchronisation:
+		/// the server's time at that synchronisation (zero if none), the millis()
+		/// value in this boot from which awake time is counted, and the totals of
+		/// awake time and requested sleep time in earlier boots.
+		double _chainEpoch_ms = 0.0;
+		double _chainUptime_ms = 0.0;
+		double _chainAwake_ms = 0.0;
+		double _chainRequested_ms = 0.0;
+
+		/// @brief true once restoreSleep() has run in this boot.
+		bool _sleepRestored = false;
+
 };
@@ -0,0 +1,268 @@
+//
+//  NodeRedTimeDiscovery.cpp
+//
+//  Created 2026-10-18.
+//
+
+#include "NodeRedTimeDiscovery.h"
+
+#if (ESP32)
+#include <ESPmDNS.h>
+#endif
+
+#if (ESP8266)
+#include <ESP8266mDNS.h>
+#endif
+
+/*
+ *	The chosen URL, kept across deep sleep. The check word is a
+ *	hash of the URL so anything else left in RTC memory (eg after
+ *	a cold boot) is ignored.
+ */
+struct NodeRedTimeRTCDiscovery {
+	uint32_t check;
+	char url[NODEREDTIME_DISCOVERY_URL_SIZE];
+};
+
+
+static uint32_t rtcDiscoveryCheck(const NodeRedTimeRTCDiscovery * rtc) {
+
+	// FNV-1a over everything after the check word
+	uint32_t hash = 0x811C9DC5 ^ 0x4E524453;
+
+	for (size_t i = 0; i < sizeof(rtc->url); i++) {
+		hash = (hash ^ (uint8_t)rtc->url[i]) * 0x01000193;
+	}
+
+	return hash;
+
+}
+
+
+#if (ESP32)
+
+// survives deep sleep (zeroed on power-up, so the check fails)
+RTC_DATA_ATTR static NodeRedTimeRTCDiscovery rtcDiscovery;
+
+#endif
+
+
+NodeRedTimeDiscovery::NodeRedTimeDiscovery(
+	NodeRedTime & clock,
+	const char * service,
+	const char * protocol
+) : _clock(clock), _service(service), _protocol(protocol) {
+
+}
+
+
+bool NodeRedTimeDiscovery::discover(bool refresh) {
+
+	// reuse the last choice unless told otherwise
+	if (!refresh) {
+
+		if (_cached.length() == 0) {
+			restoreCache();
+		}
+
+		if (_cached.length() > 0) {
+
+			if (_clock.url() != _cached) {
+				_clock.setServer(_cached.c_str());
+			}
+
+			return true;
+
+		}
+
+	}
+
+	// browse (blocks for the mDNS query timeout)
+	int answers = MDNS.queryService(_service, _protocol);
+
+	_count = 0;
+
+	for (int i = 0; i < answers && _count < NODEREDTIME_DISCOVERY_CANDIDATES; i++) {
+
+		Candidate & candidate = _candidates[_count];
+		candidate.url = answerURL(i, &candidate.priority);
+		candidate.rtt_ms = -1.0;
+
+		if (candidate.url.length() > 0) {
+			_count++;
+		}
+
+	}
+
+	/*
+	 *	Measure every candidate with a real synchronisation (which
+	 *	also proves it serves time, not just that it answers), then
+	 *	prefer the lowest priority value and, within it, the
+	 *	shortest round trip.
+	 */
+	String original = _clock.url();
+	int best = -1;
+
+	for (size_t i = 0; i < _count; i++) {
+
+		Candidate & candidate = _candidates[i];
+		candidate.rtt_ms = probe(candidate.url);
+
+		if (candidate.rtt_ms < 0.0) {
+			continue;
+		}
+
+		if (
+			best < 0 ||
+			candidate.priority < _candidates[best].priority ||
+			(candidate.priority == _candidates[best].priority && candidate.rtt_ms < _candidates[best].rtt_ms)
+		) {
+			best = i;
+		}
+
+	}
+
+	// nothing usable - back to where we started
+	if (best < 0) {
+
+		if (_clock.url() != original) {
+			_clock.setServer(original.c_str());
+		}
+
+		return false;
+
+	}
+
+	_cached = _candidates[best].url;
+	_clock.setServer(_cached.c_str());
+	saveCache();
+
+	return true;
+
+}
+
+
+String NodeRedTimeDiscovery::answerURL(int i, int * priority) {
+
+	String scheme = "http";
+	String path = "/time/";
+	*priority = 0;
+
+	#if (ESP32)
+
+	if (MDNS.hasTxt(i, "scheme")) {
+		scheme = MDNS.txt(i, "scheme");
+	}
+	if (MDNS.hasTxt(i, "path")) {
+		path = MDNS.txt(i, "path");
+	}
+	if (MDNS.hasTxt(i, "priority")) {
+		*priority = MDNS.txt(i, "priority").toInt();
+	}
+
+	#endif
+
+	if (!path.startsWith("/")) {
+		path = "/" + path;
+	}
+
+	/*
+	 *	Use the address from the answer, which saves resolving
+	 *	it again - except for https, where the certificate is
+	 *	checked against the name.
+	 */
+	String host = scheme.equalsIgnoreCase("https") ?
+		String(MDNS.hostname(i)) + ".local" :
+		MDNS.IP(i).toString();
+
+	String url = scheme + "://" + host + ":" + String(MDNS.port(i)) + path;
+
+	// too long to cache across deep sleep is too long to use
+	if (url.length() >= NODEREDTIME_DISCOVERY_URL_SIZE) {
+		return String();
+	}
+
+	return url;
+
+}
+
+
+double NodeRedTimeDiscovery::probe(const String & url) {
+
+	_clock.setServer(url.c_str());
+
+	// the budget may refuse, in which case nothing was measured
+	unsigned long attempts = _clock.stats().syncAttempts;
+	unsigned long failures = _clock.stats().syncFailures;
+
+	time_t epoch;
+	_clock.serverTime(&epoch);
+
+	const NodeRedTime::Stats & stats = _clock.stats();
+
+	// a failure leaves the last synchronisation point alone
+	if (stats.syncAttempts == attempts || stats.syncFailures != failures) {
+
+		return -1.0;
+
+	}
+
+	/*
+	 *	The estimate was reset by setServer() so this is the one
+	 *	sample. A reply within the millisecond measures as zero:
+	 *	report 1 ms so a measured round trip is always positive.
+	 */
+	return max(stats.srtt_ms, 1.0);
+
+}
+
+
+void NodeRedTimeDiscovery::forget() {
+
+	_cached = String();
+	saveCache();
+
+}
+
+
+void NodeRedTimeDiscovery::saveCache() {
+
+	NodeRedTimeRTCDiscovery rtc;
+
+	memset(rtc.url, 0, sizeof(rtc.url));
+	strncpy(rtc.url, _cached.c_str(), sizeof(rtc.url) - 1);
+	rtc.check = _cached.length() > 0 ? rtcDiscoveryCheck(&rtc) : 0;
+
+	#if (ESP8266)
+	ESP.rtcUserMemoryWrite(NodeRedTime::rtcFreeBlock(), (uint32_t *)&rtc, sizeof(rtc));
+	#endif
+
+	#if (ESP32)
+	rtcDiscovery = rtc;
+	#endif
+
+}
+
+
+void NodeRedTimeDiscovery::restoreCache() {
+
+	NodeRedTimeRTCDiscovery rtc;
+
+	#if (ESP8266)
+	if (!ESP.rtcUserMemoryRead(NodeRedTime::rtcFreeBlock(), (uint32_t *)&rtc, sizeof(rtc))) {
+		return;
+	}
+	#endif
+
+	#if (ESP32)
+	rtc = rtcDiscovery;
+	#endif
+
+	if (rtc.check != rtcDiscoveryCheck(&rtc)) {
+		return;
+	}
+
+	rtc.url[sizeof(rtc.url) - 1] = '\0';
+	_cached = String(rtc.url);
+
+}
@@ -0,0 +1,136 @@
+//
+//  NodeRedTimeDiscovery.h
+//
+//  Created 2026-10-18.
+//
+
+#pragma once
+
+#include "NodeRedTime.h"
+
+/// @brief most candidate servers considered by one discovery.
+#ifndef NODEREDTIME_DISCOVERY_CANDIDATES
+#define NODEREDTIME_DISCOVERY_CANDIDATES 4
+#endif
+
+/// @brief longest URL which can be cached across deep sleep.
+#ifndef NODEREDTIME_DISCOVERY_URL_SIZE
+#define NODEREDTIME_DISCOVERY_URL_SIZE 64
+#endif
+
+/*!	@brief Find the Node-Red time service with DNS-SD instead of a fixed URL.
+**
+**	Browses (via mDNS) for instances of a DNS-SD service, by default
+**	"_noderedtime._tcp", builds a URL for each, measures the round-trip time
+**	to each with a real synchronisation, and points the NodeRedTime object at
+**	the best one. Moving the Node-Red host then needs no reflashing, and a
+**	device with several servers in range picks the nearest.
+**
+**	On ESP32, each instance's TXT record may carry:
+**	- "scheme" http (default), https or coap;
+**	- "path" the resource (default "/time/"); and
+**	- "priority" lower is preferred (default 0). A server is only chosen over
+**	  one with a lower priority value if every such server failed to respond.
+**	The ESP8266 mDNS library's legacy query API does not expose TXT records,
+**	so on ESP8266 every instance is http with path "/time/" and priority 0.
+**
+**	The choice is cached in RAM and in RTC memory (on ESP8266, from
+**	NodeRedTime::rtcFreeBlock()) so browsing happens once per power cycle, not
+**	once per wake. Call discover(true) to browse again, eg after
+**	synchronisation has failed several times in a row.
+**
+**	Sample code:
+**	@code{.cpp}
+**	#include <NodeRedTimeDiscovery.h>
+**	NodeRedTime nodeRedTime("http://fallback.domain.com:1880/time/");
+**	NodeRedTimeDiscovery discovery(nodeRedTime);
+**	...
+**	MDNS.begin("sensor-17");
+**	discovery.discover();
+**	@endcode
+**
+**	@remark The sketch must start the mDNS responder (MDNS.begin()) before
+**	calling discover(). If nothing is found, or nothing responds, the
+**	NodeRedTime object keeps the URL it had.
+*/
+class NodeRedTimeDiscovery {
+
+    public:
+
+		/// @brief a discovered server.
+		struct Candidate {
+			String url;			///< URL built from the advertisement
+			int priority;		///< from the TXT record (lower preferred)
+			double rtt_ms;		///< measured round trip (negative if it did not respond)
+		};
+
+
+		/*!	@brief NodeRedTimeDiscovery constructor
+		**
+		**	@param [in] clock the NodeRedTime object to configure. Must outlive
+		**	this object.
+		**
+		**	@param [in] service DNS-SD service name without the leading underscore.
+		**	Defaults to "noderedtime".
+		**
+		**	@param [in] protocol "tcp" (default) or "udp". Advertise CoAP servers
+		**	under either; the scheme comes from the TXT record.
+		**
+		**	@return nothing.
+		**/
+		NodeRedTimeDiscovery(
+			NodeRedTime & clock,
+			const char * service = "noderedtime",
+			const char * protocol = "tcp"
+		);
+
+
+		/*!	@brief Choose a server
+		**
+		**	@param [in] refresh **false** (default) to reuse a cached choice if
+		**	there is one. **true** to browse and measure again.
+		**
+		**	@return **true** if the NodeRedTime object now points at a discovered
+		**	(or cached) server.
+		**/
+		bool discover(bool refresh = false);
+
+
+		/// @brief forget the cached choice (RAM and RTC memory).
+		void forget();
+
+
+		/// @brief number of candidates found by the last browse.
+		size_t candidates() const { return _count; }
+
+		/// @brief candidate i (0..candidates()-1) from the last browse.
+		const Candidate & candidate(size_t i) const { return _candidates[i]; }
+
+
+    protected:
+
+		/// @brief URL (and priority) of mDNS answer i, empty if unusable.
+		String answerURL(int i, int * priority);
+
+		/// @brief synchronise with url; round trip in milliseconds, or negative.
+		/// A failure leaves the last synchronisation point as it was.
+		double probe(const String & url);
+
+		/// @brief copy _cached to RTC memory.
+		void saveCache();
+
+		/// @brief recover _cached from RTC memory (if valid).
+		void restoreCache();
+
+		NodeRedTime & _clock;
+		const char * _service;
+		const char * _protocol;
+
+		/// @brief candidates from the last browse
+		Candidate _candidates[NODEREDTIME_DISCOVERY_CANDIDATES];
+		size_t _count = 0;
+
+		/// @brief URL of the chosen server (empty if none)
+		String _cached;
+
+};
@@ -0,0 +1,181 @@
+//
+//  NodeRedTimeId.cpp
+//
+//  Created 2026-10-18.
+//
+
+#include "NodeRedTimeId.h"
+
+/*
+ *	The reservation carried across deep sleep. The check word covers
+ *	the reservation and the custom epoch, so garbage (or a generator
+ *	counting from a different epoch) is ignored.
+ */
+struct NodeRedTimeRTCId {
+	uint32_t check;
+	uint32_t reservedLow;
+	uint32_t reservedHigh;
+};
+
+
+static uint32_t rtcIdCheck(const NodeRedTimeRTCId * rtc, double customEpoch_ms) {
+
+	// FNV-1a over everything after the check word, then the epoch
+	uint32_t hash = 0x811C9DC5 ^ 0x4E524944;
+	uint32_t words[3] = { rtc->reservedLow, rtc->reservedHigh, (uint32_t)(customEpoch_ms / 1000.0) };
+
+	const uint8_t * p = (const uint8_t *)words;
+	for (size_t i = 0; i < sizeof(words); i++) {
+		hash = (hash ^ p[i]) * 0x01000193;
+	}
+
+	return hash;
+
+}
+
+
+#if (ESP32)
+
+// survives deep sleep (zeroed on power-up, so the check fails)
+RTC_DATA_ATTR static NodeRedTimeRTCId rtcId;
+
+#endif
+
+
+NodeRedTimeId::NodeRedTimeId(
+	NodeRedTime & clock,
+	const uint16_t deviceId,
+	const time_t customEpoch_s
+) : _clock(clock) {
+
+	// device ID sits between the timestamp and the sequence
+	_device = (uint64_t)(deviceId & 0x3FF) << 12;
+
+	// converted to milliseconds for comparison with syntheticMillis()
+	_customEpoch_ms = 1000.0 * customEpoch_s;
+
+	// carry on past anything issued before deep sleep
+	NodeRedTimeRTCId rtc;
+
+	#if (ESP8266)
+	if (!ESP.rtcUserMemoryRead(NODEREDTIME_ID_RTC_BLOCK, (uint32_t *)&rtc, sizeof(rtc))) {
+		return;
+	}
+	#endif
+
+	#if (ESP32)
+	rtc = rtcId;
+	#endif
+
+	if (rtc.check == rtcIdCheck(&rtc, _customEpoch_ms)) {
+		uint64_t reserved = ((uint64_t)rtc.reservedHigh << 32) | rtc.reservedLow;
+		_last = reserved;
+		_reserved = reserved;
+	}
+
+}
+
+
+bool NodeRedTimeId::next(uint64_t * id) {
+
+	double epoch_ms;
+
+	if (!_clock.syntheticMillis(&epoch_ms)) {
+		epoch_ms = 0.0;
+	}
+
+	return nextAt(epoch_ms, id);
+
+}
+
+
+bool NodeRedTimeId::nextAt(double epoch_ms, uint64_t * id) {
+
+	// milliseconds since the custom epoch, shifted past the sequence
+	uint64_t now = 0;
+
+	if (epoch_ms > _customEpoch_ms) {
+
+		now = (uint64_t)(epoch_ms - _customEpoch_ms) << 12;
+
+	}
+
+	/*
+	 *	The next state is the later of "now with sequence zero"
+	 *	and "one more than last time". The second case covers
+	 *	both several IDs in one millisecond and synthetic time
+	 *	stepping backwards after a resynchronisation.
+	 */
+	#if (ESP32)
+
+	uint64_t last = _last.load();
+	uint64_t state;
+
+	do {
+
+		if (now == 0 && last == 0) {
+			return false;
+		}
+
+		state = max(now, last + 1);
+
+	} while (!_last.compare_exchange_weak(last, state));
+
+	#else
+
+	if (now == 0 && _last == 0) {
+		return false;
+	}
+
+	uint64_t state = max(now, _last + 1);
+	_last = state;
+
+	#endif
+
+	// about once a reservation period
+	if (state >= _reserved) {
+		reserve(state);
+	}
+
+	// split the state around the device ID
+	*id = ((state >> 12) << 22) | _device | (state & 0xFFF);
+
+	return true;
+
+}
+
+
+void NodeRedTimeId::reserve(uint64_t state) {
+
+	uint64_t reserved = state + ((uint64_t)NODEREDTIME_ID_RESERVE_MS << 12);
+
+	/*
+	 *	Only the task which moves the reservation on saves it. Two
+	 *	saves can only race if IDs have advanced a whole
+	 *	reservation period in between.
+	 */
+	#if (ESP32)
+	uint64_t previous = _reserved.load();
+	do {
+		if (previous > state) {
+			return;
+		}
+	} while (!_reserved.compare_exchange_weak(previous, reserved));
+	#else
+	_reserved = reserved;
+	#endif
+
+	NodeRedTimeRTCId rtc;
+	rtc.reservedLow = (uint32_t)reserved;
+	rtc.reservedHigh = (uint32_t)(reserved >> 32);
+	rtc.check = rtcIdCheck(&rtc, _customEpoch_ms);
+
+	#if (ESP8266)
+	ESP.rtcUserMemoryWrite(NODEREDTIME_ID_RTC_BLOCK, (uint32_t *)&rtc, sizeof(rtc));
+	#endif
+
+	#if (ESP32)
+	rtcId = rtc;
+	#endif
+
+}
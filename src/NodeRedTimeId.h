@@ -0,0 +1,156 @@
+//
+//  NodeRedTimeId.h
+//
+//  Created 2026-10-18.
+//
+
+#pragma once
+
+#include "NodeRedTime.h"
+
+#if (ESP32)
+#include <atomic>
+#endif
+
+/// @brief how far (milliseconds) ahead of the IDs issued the generator
+/// reserves in RTC memory. Bounds how often RTC memory is written (once per
+/// this many milliseconds of IDs) and how far ahead of synthetic time the
+/// first IDs after waking may be.
+#ifndef NODEREDTIME_ID_RESERVE_MS
+#define NODEREDTIME_ID_RESERVE_MS 1000
+#endif
+
+/// @brief first of the three 4-byte blocks of ESP8266 RTC user memory in
+/// which the reservation is kept. Defaults to the last 12 bytes, clear of
+/// NodeRedTime's own records (from NODEREDTIME_RTC_OFFSET) and
+/// NodeRedTimeDiscovery's cache.
+#ifndef NODEREDTIME_ID_RTC_BLOCK
+#define NODEREDTIME_ID_RTC_BLOCK 125
+#endif
+
+/*!	@brief Fleet-wide unique, roughly time-ordered 64-bit record IDs.
+**
+**	IDs follow the Snowflake layout:
+**	- bit 63 always zero (IDs are positive as signed 64-bit integers);
+**	- bits 62..22 milliseconds since a custom epoch (41 bits, ~69 years);
+**	- bits 21..12 device ID (10 bits, 0..1023); and
+**	- bits 11..0 sequence number within the millisecond (12 bits).
+**
+**	The millisecond comes from NodeRedTime::syntheticMillis(), so no round
+**	trip to a server is needed to issue an ID. IDs from one generator are
+**	strictly increasing even if a resynchronisation steps synthetic time
+**	backwards: the generator never issues a timestamp earlier than the last
+**	one, and if the 4096 sequence numbers of a millisecond are used up it
+**	borrows the next millisecond. Uniqueness across the fleet relies on every
+**	device having a different device ID.
+**
+**	The order survives deep sleep too. Rather than write RTC memory for
+**	every ID, the generator reserves NODEREDTIME_ID_RESERVE_MS ahead of the
+**	IDs it issues (in RTC_DATA_ATTR memory on ESP32, RTC user memory from
+**	NODEREDTIME_ID_RTC_BLOCK on ESP8266) and, after waking, carries on from
+**	the end of the reservation. Only one generator per device is covered.
+**	A power cycle clears RTC memory, so IDs issued just before one may be
+**	repeated if the clock comes back behind where it was.
+**
+**	@remark The generator state is updated with compare-and-swap (a
+**	std::atomic on ESP32; ESP8266 has one core), so nextAt() may be called
+**	from any task without a lock. next() also reads synthetic time, which
+**	may synchronise over the NodeRedTime object's shared client, so call it
+**	only from the task which uses that object - other tasks can pass a time
+**	obtained there to nextAt(). The Xtensa cores have no 64-bit
+**	compare-and-swap, so the runtime emulates it.
+*/
+class NodeRedTimeId {
+
+    public:
+
+		/*!	@brief NodeRedTimeId constructor
+		**
+		**	Sample code:
+		**	@code{.cpp}
+		**	#include <NodeRedTimeId.h>
+		**	NodeRedTime nodeRedTime("http://host.domain.com:1880/time/");
+		**	NodeRedTimeId recordIds(nodeRedTime, 17);
+		**	@endcode
+		**
+		**	@param [in] clock the NodeRedTime object which supplies synthetic time.
+		**	Must outlive the generator.
+		**
+		**	@param [in] deviceId this device's ID, unique within the fleet. Only
+		**	the low 10 bits are used.
+		**
+		**	@param [in] customEpoch_s the epoch (Unix seconds) from which the
+		**	millisecond field counts. Defaults to 1577836800 (2020-01-01T00:00:00Z).
+		**	Must be the same on every device in the fleet.
+		**
+		**	@return nothing.
+		**/
+		NodeRedTimeId(
+			NodeRedTime & clock,
+			const uint16_t deviceId,
+			const time_t customEpoch_s = 1577836800
+		);
+
+
+		/*!	@brief Issue the next ID
+		**
+		**	@param [out] id pointer to the ID, must not be nil.
+		**
+		**	@return **true** if an ID was issued. **false** only if synthetic time
+		**	has never been available (after that, IDs continue to be issued from
+		**	the last one even if synchronisation fails).
+		**/
+		bool next(uint64_t * id) __attribute__((nonnull));
+
+
+		/*!	@brief Issue the next ID for a time obtained elsewhere
+		**
+		**	Lock-free: may be called from any task, concurrently with next().
+		**
+		**	@param [in] epoch_ms Unix epoch milliseconds (eg from syntheticMillis()
+		**	in another task). Zero or earlier than the custom epoch if unknown.
+		**
+		**	@param [out] id pointer to the ID, must not be nil.
+		**
+		**	@return as for next().
+		**/
+		bool nextAt(double epoch_ms, uint64_t * id) __attribute__((nonnull));
+
+
+		/// @brief Unix epoch milliseconds at which an ID was issued.
+		double idMillis(uint64_t id) const { return (id >> 22) + _customEpoch_ms; }
+
+		/// @brief device ID part of an ID.
+		static uint16_t idDevice(uint64_t id) { return (id >> 12) & 0x3FF; }
+
+		/// @brief sequence part of an ID.
+		static uint16_t idSequence(uint64_t id) { return id & 0xFFF; }
+
+
+    protected:
+
+		/// @brief supplies synthetic time. Initialized by constructor.
+		NodeRedTime & _clock;
+
+		/// @brief device ID shifted into place. Initialized by constructor.
+		uint64_t _device;
+
+		/// @brief custom epoch in Unix milliseconds. Initialized by constructor.
+		double _customEpoch_ms;
+
+		/// @brief save a reservation covering state (the first to get past
+		/// _reserved does so).
+		void reserve(uint64_t state);
+
+		/// @brief the last (milliseconds << 12 | sequence) issued, and the end
+		/// of the reservation saved in RTC memory. Zero until the first ID is
+		/// issued (or restored from RTC memory by the constructor).
+		#if (ESP32)
+		std::atomic<uint64_t> _last { 0 };
+		std::atomic<uint64_t> _reserved { 0 };
+		#else
+		uint64_t _last = 0;
+		uint64_t _reserved = 0;
+		#endif
+
+};
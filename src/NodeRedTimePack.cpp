@@ -0,0 +1,240 @@
+//
+//  NodeRedTimePack.cpp
+//
+//  Created 2026-10-18.
+//
+
+#include "NodeRedTimePack.h"
+
+// epoch milliseconds must fit the 6 bytes of an anchor
+static const uint64_t MaxEpoch_ms = ((uint64_t)1 << 48) - 1;
+
+// a delta needing more bytes than this is written as an anchor instead
+static const size_t MaxVarintSize = 6;
+
+
+static uint64_t zigzag(int64_t delta) {
+	return ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+}
+
+
+static int64_t unzigzag(uint64_t value) {
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+
+NodeRedTimePacker::NodeRedTimePacker(
+	NodeRedTime & clock,
+	uint8_t * buffer,
+	size_t size
+) : _clock(clock), _buffer(buffer), _size(size) {
+
+}
+
+
+bool NodeRedTimePacker::stamp(double * epoch_ms) {
+
+	double now_ms;
+
+	if (!_clock.syntheticMillis(&now_ms) || !append(now_ms)) {
+		return false;
+	}
+
+	if (epoch_ms) {
+		*epoch_ms = (double)_last_ms;
+	}
+
+	return true;
+
+}
+
+
+bool NodeRedTimePacker::append(double epoch_ms) {
+
+	if (epoch_ms < 0.0 || epoch_ms > (double)MaxEpoch_ms) {
+		return false;
+	}
+
+	uint64_t now_ms = (uint64_t)epoch_ms;
+
+	// zero-based so 0 can mark an anchor
+	uint64_t value = zigzag((int64_t)(now_ms - _last_ms)) + 1;
+
+	if (
+		_sinceAnchor > 0 &&
+		_sinceAnchor < NODEREDTIME_PACK_REANCHOR &&
+		value < ((uint64_t)1 << (7 * MaxVarintSize))
+	) {
+
+		if (!appendVarint(value)) {
+			return false;
+		}
+
+		_sinceAnchor++;
+
+	} else {
+
+		if (_length + MaxSampleSize > _size) {
+			return false;
+		}
+
+		_buffer[_length++] = 0;
+		for (int shift = 40; shift >= 0; shift -= 8) {
+			_buffer[_length++] = now_ms >> shift;
+		}
+
+		_sinceAnchor = 1;
+
+	}
+
+	_last_ms = now_ms;
+	_count++;
+
+	return true;
+
+}
+
+
+bool NodeRedTimePacker::appendVarint(uint64_t value) {
+
+	// measure first so a full buffer is left untouched
+	size_t bytes = 1;
+	for (uint64_t rest = value >> 7; rest > 0; rest >>= 7) {
+		bytes++;
+	}
+
+	if (_length + bytes > _size) {
+		return false;
+	}
+
+	while (value >= 0x80) {
+		_buffer[_length++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	_buffer[_length++] = value;
+
+	return true;
+
+}
+
+
+bool NodeRedTimePacker::resume(size_t length) {
+
+	clear();
+
+	if (length > _size) {
+		return false;
+	}
+
+	NodeRedTimeUnpacker unpacker(_buffer, length);
+	double epoch_ms;
+
+	// replay the stream, tracking what append() would have
+	while (unpacker.next(&epoch_ms)) {
+
+		_sinceAnchor = (_buffer[_length] == 0) ? 1 : _sinceAnchor + 1;
+		_length = unpacker.position();
+		_last_ms = (uint64_t)epoch_ms;
+		_count++;
+
+	}
+
+	if (unpacker.malformed() || _length != length) {
+		clear();
+		return false;
+	}
+
+	return true;
+
+}
+
+
+void NodeRedTimePacker::clear() {
+
+	_length = 0;
+	_count = 0;
+	_last_ms = 0;
+	_sinceAnchor = 0;
+
+}
+
+
+NodeRedTimeUnpacker::NodeRedTimeUnpacker(
+	const uint8_t * buffer,
+	size_t length
+) : _buffer(buffer), _length(length) {
+
+}
+
+
+bool NodeRedTimeUnpacker::next(double * epoch_ms) {
+
+	if (_malformed || _position >= _length) {
+		return false;
+	}
+
+	// anchor: zero then 6 bytes big-endian
+	if (_buffer[_position] == 0) {
+
+		if (_position + NodeRedTimePacker::MaxSampleSize > _length) {
+			_malformed = true;
+			return false;
+		}
+
+		uint64_t anchor_ms = 0;
+		for (size_t i = 1; i < NodeRedTimePacker::MaxSampleSize; i++) {
+			anchor_ms = (anchor_ms << 8) | _buffer[_position + i];
+		}
+
+		_position += NodeRedTimePacker::MaxSampleSize;
+		_last_ms = anchor_ms;
+		_anchored = true;
+
+		*epoch_ms = (double)_last_ms;
+		return true;
+
+	}
+
+	// delta: needs an anchor before it
+	uint64_t value = 0;
+	size_t i = _position;
+
+	for (int shift = 0; ; shift += 7) {
+
+		if (!_anchored || i >= _length || shift >= (int)(7 * MaxVarintSize)) {
+			_malformed = true;
+			return false;
+		}
+
+		uint8_t byte = _buffer[i++];
+		value |= (uint64_t)(byte & 0x7F) << shift;
+
+		if ((byte & 0x80) == 0) {
+			break;
+		}
+
+	}
+
+	// zero is never written (it would be read as an anchor)
+	if (value == 0) {
+		_malformed = true;
+		return false;
+	}
+
+	_position = i;
+	_last_ms += unzigzag(value - 1);
+
+	*epoch_ms = (double)_last_ms;
+	return true;
+
+}
+
+
+void NodeRedTimeUnpacker::rewind() {
+
+	_position = 0;
+	_last_ms = 0;
+	_anchored = false;
+	_malformed = false;
+
+}
@@ -0,0 +1,210 @@
+//
+//  NodeRedTimePack.h
+//
+//  Created 2026-10-18.
+//
+
+#pragma once
+
+#include "NodeRedTime.h"
+
+/// @brief samples between anchors. Bounds how much is lost to a damaged
+/// byte and lets a reader start at any anchor.
+#ifndef NODEREDTIME_PACK_REANCHOR
+#define NODEREDTIME_PACK_REANCHOR 64
+#endif
+
+/*!	@brief Pack sample timestamps into a byte buffer, a few bytes each.
+**
+**	A logger which buffers readings between uploads would otherwise spend 8
+**	bytes (a double or a uint64_t) on each timestamp. The packer stores:
+**	- an anchor: a zero byte followed by the 48-bit epoch milliseconds (7
+**	  bytes); then
+**	- for each later sample, the signed milliseconds since the previous
+**	  sample, zigzag-encoded (0, -1, 1, -2 ... become 0, 1, 2, 3 ...), plus
+**	  one, as a little-endian base-128 varint. Up to 63ms either way takes one
+**	  byte, up to 8.2s two and up to 17.4 minutes three.
+**
+**	Signed deltas mean a resynchronisation which steps synthetic time
+**	backwards costs no more than one which steps it forwards. A new anchor is
+**	only written for the first sample and then after every
+**	NODEREDTIME_PACK_REANCHOR samples.
+**
+**	NodeRedTimeUnpacker rebuilds the exact epoch milliseconds.
+**
+**	Sample code (ESP32; on ESP8266 copy the buffer to and from RTC user
+**	memory, or flash):
+**	@code{.cpp}
+**	#include <NodeRedTimePack.h>
+**	RTC_DATA_ATTR uint8_t stamps[1024];
+**	RTC_DATA_ATTR size_t stampsLength;
+**	NodeRedTimePacker packer(nodeRedTime, stamps, sizeof(stamps));
+**	...
+**	packer.resume(stampsLength);		// after waking
+**	if (packer.stamp()) {
+**		stampsLength = packer.length();
+**		...
+**	}
+**	@endcode
+*/
+class NodeRedTimePacker {
+
+    public:
+
+		/// @brief most bytes a single sample can take (an anchor).
+		static const size_t MaxSampleSize = 7;
+
+
+		/*!	@brief NodeRedTimePacker constructor
+		**
+		**	@param [in] clock the NodeRedTime object which supplies synthetic time.
+		**	Must outlive the packer.
+		**
+		**	@param [in] buffer where the packed timestamps are written. Must
+		**	outlive the packer.
+		**
+		**	@param [in] size size of buffer in bytes.
+		**
+		**	@return nothing. The packer starts empty.
+		**/
+		NodeRedTimePacker(NodeRedTime & clock, uint8_t * buffer, size_t size);
+
+
+		/*!	@brief Append the current synthetic time
+		**
+		**	@param [out] epoch_ms optional pointer to the timestamp appended (as
+		**	decoded).
+		**
+		**	@return **true** if synthetic time was available and there was room
+		**	for it.
+		**/
+		bool stamp(double * epoch_ms = nullptr);
+
+
+		/*!	@brief Append a timestamp obtained elsewhere
+		**
+		**	@param [in] epoch_ms whole Unix epoch milliseconds (any fraction is
+		**	discarded).
+		**
+		**	@return **true** if there was room for it. **false** if the buffer is
+		**	full or epoch_ms is negative or beyond 48 bits.
+		**/
+		bool append(double epoch_ms);
+
+
+		/*!	@brief Continue a buffer packed earlier (eg before deep sleep)
+		**
+		**	Decodes the first length bytes of the buffer to recover the last
+		**	timestamp and the number of samples since the last anchor.
+		**
+		**	@param [in] length bytes in use, as returned by length().
+		**
+		**	@return **true** if those bytes decoded cleanly. If **false** the
+		**	packer is emptied.
+		**/
+		bool resume(size_t length);
+
+
+		/// @brief discard everything packed so far (eg after an upload).
+		void clear();
+
+		/// @brief bytes in use (to upload, or to save for resume()).
+		size_t length() const { return _length; }
+
+		/// @brief samples in the buffer.
+		size_t count() const { return _count; }
+
+		/// @brief the buffer passed to the constructor.
+		const uint8_t * buffer() const { return _buffer; }
+
+
+    protected:
+
+		/// @brief append an unsigned base-128 varint (false if no room).
+		bool appendVarint(uint64_t value);
+
+		/// @brief supplies synthetic time. Initialized by constructor.
+		NodeRedTime & _clock;
+
+		/// @brief the buffer and its size. Initialized by constructor.
+		uint8_t * _buffer;
+		size_t _size;
+
+		/// @brief bytes in use and samples appended.
+		size_t _length = 0;
+		size_t _count = 0;
+
+		/// @brief the previous sample (epoch milliseconds) and samples since the
+		/// last anchor (zero forces an anchor).
+		uint64_t _last_ms = 0;
+		uint32_t _sinceAnchor = 0;
+
+};
+
+
+/*!	@brief Recover the timestamps written by a NodeRedTimePacker.
+**
+**	Needs no NodeRedTime object, so the same code can run on the device or,
+**	compiled for a host, on whatever receives the upload.
+**
+**	Sample code:
+**	@code{.cpp}
+**	NodeRedTimeUnpacker unpacker(stamps, stampsLength);
+**	double epoch_ms;
+**	while (unpacker.next(&epoch_ms)) {
+**		...
+**	}
+**	@endcode
+*/
+class NodeRedTimeUnpacker {
+
+    public:
+
+		/*!	@brief NodeRedTimeUnpacker constructor
+		**
+		**	@param [in] buffer packed timestamps. Must outlive the unpacker.
+		**	@param [in] length bytes of buffer in use.
+		**
+		**	@return nothing.
+		**/
+		NodeRedTimeUnpacker(const uint8_t * buffer, size_t length);
+
+
+		/*!	@brief Decode the next timestamp
+		**
+		**	@param [out] epoch_ms pointer to whole Unix epoch milliseconds, must
+		**	not be nil.
+		**
+		**	@return **true** if a timestamp was decoded. **false** at the end of
+		**	the buffer or if it is malformed (see malformed()).
+		**/
+		bool next(double * epoch_ms) __attribute__((nonnull));
+
+
+		/// @brief true if next() stopped at bytes which could not be decoded.
+		bool malformed() const { return _malformed; }
+
+		/// @brief bytes decoded so far.
+		size_t position() const { return _position; }
+
+		/// @brief start again from the beginning of the buffer.
+		void rewind();
+
+
+    protected:
+
+		/// @brief the buffer and its length. Initialized by constructor.
+		const uint8_t * _buffer;
+		size_t _length;
+
+		/// @brief next byte to decode and the previous timestamp.
+		size_t _position = 0;
+		uint64_t _last_ms = 0;
+
+		/// @brief true once an anchor has been seen.
+		bool _anchored = false;
+
+		/// @brief set by next() on bytes which cannot be decoded.
+		bool _malformed = false;
+
+};
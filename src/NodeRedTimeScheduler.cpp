@@ -0,0 +1,307 @@
+//
+//  NodeRedTimeScheduler.cpp
+//
+//  Created 2026-10-18.
+//
+
+#include "NodeRedTimeScheduler.h"
+
+#include <limits.h>
+#include <stdlib.h>
+
+NodeRedTimeScheduler::NodeRedTimeScheduler(NodeRedTime & clock) : _clock(clock) {
+
+}
+
+
+NodeRedTimeScheduler::NodeRedTimeScheduler(NodeRedTime & clock, const NodeRedTimeZone & zone) :
+	_clock(clock),
+	_zone(zone),
+	_followTz(false)
+{
+
+}
+
+
+bool NodeRedTimeScheduler::every(
+	unsigned long period_s,
+	Callback callback,
+	unsigned long offset_s
+) {
+
+	if (period_s == 0) {
+		return false;
+	}
+
+	Job job = { callback, period_s, offset_s % period_s, EVERY_DAY, 0, 0, 0 };
+
+	return add(job);
+
+}
+
+
+bool NodeRedTimeScheduler::daily(
+	uint8_t hour,
+	uint8_t minute,
+	Callback callback,
+	uint8_t weekdays
+) {
+
+	if (hour > 23 || minute > 59 || (weekdays & EVERY_DAY) == 0) {
+		return false;
+	}
+
+	Job job = { callback, 0, 3600UL * hour + 60UL * minute, weekdays, 0, 0, 0 };
+
+	return add(job);
+
+}
+
+
+bool NodeRedTimeScheduler::add(const Job & job) {
+
+	if (_count >= NODEREDTIME_SCHEDULER_JOBS) {
+		return false;
+	}
+
+	_jobs[_count] = job;
+	_heap[_count] = _count;
+	_count++;
+
+	// fire times are (re)computed by the next poll()
+	_scheduled = false;
+	_retry_ms = millis();
+
+	return true;
+
+}
+
+
+unsigned int NodeRedTimeScheduler::poll() {
+
+	unsigned long now_ms = millis();
+
+	/*
+	 *	Recompute everything if jobs have been added or the
+	 *	synchronisation point has moved. Synthetic time may not
+	 *	be available yet, in which case try again a second later
+	 *	rather than asking NodeRedTime on every poll().
+	 */
+	if (!_scheduled || _generation != _clock.syncGeneration()) {
+
+		if ((long)(now_ms - _retry_ms) < 0) {
+			return 0;
+		}
+
+		if (!reschedule()) {
+			_retry_ms = now_ms + 1000;
+			return 0;
+		}
+
+	}
+
+	unsigned int fired = 0;
+
+	// the top of the heap is the next job due
+	while (_count > 0 && (long)(now_ms - _jobs[_heap[0]].due_ms) >= 0) {
+
+		Job & job = _jobs[_heap[0]];
+		time_t due = job.due;
+		job.fired = due;
+
+		/*
+		 *	Schedule the following occurrence after the wallclock
+		 *	now (due_ms and due are the same moment), so a late
+		 *	poll() skips missed occurrences rather than firing them
+		 *	in a burst.
+		 */
+		nextDue(job, due + (long)(now_ms - job.due_ms) / 1000);
+		job.due_ms += 1000UL * (job.due - due);
+		siftDown(0);
+
+		job.callback(due);
+		fired++;
+
+		// a callback which synchronised moves every job
+		if (_generation != _clock.syncGeneration()) {
+			break;
+		}
+
+	}
+
+	return fired;
+
+}
+
+
+unsigned long NodeRedTimeScheduler::msUntilNext() {
+
+	if (!_scheduled || _count == 0) {
+		return ULONG_MAX;
+	}
+
+	long remaining_ms = (long)(_jobs[_heap[0]].due_ms - millis());
+
+	return remaining_ms > 0 ? remaining_ms : 0;
+
+}
+
+
+bool NodeRedTimeScheduler::reschedule() {
+
+	double epoch_ms;
+
+	if (!_clock.syntheticMillis(&epoch_ms)) {
+		return false;
+	}
+
+	// wallclock and millis() for the same moment
+	unsigned long uptime_ms = millis();
+	time_t now = epoch_ms / 1000.0;
+
+	// TZ may have been set (or changed) since the last time
+	if (_followTz) {
+		const char * tz = getenv("TZ");
+		_zone = NodeRedTimeZone((tz != nullptr && *tz != '\0') ? tz : "UTC0");
+	}
+
+	for (uint8_t i = 0; i < _count; i++) {
+
+		Job & job = _jobs[i];
+
+		/*
+		 *	A job which was due by now but has not fired (eg poll()
+		 *	stopped when a callback synchronised) stays due. Any
+		 *	other job moves to its next occurrence, but never back
+		 *	to (or before) the one it last fired for, which a
+		 *	backward step would otherwise repeat.
+		 */
+		if (job.due == 0 || job.due > now) {
+			nextDue(job, max(now, job.fired));
+		}
+
+		setDue_ms(job, epoch_ms, uptime_ms);
+		_heap[i] = i;
+
+	}
+
+	// heapify
+	for (int i = _count / 2 - 1; i >= 0; i--) {
+		siftDown(i);
+	}
+
+	_generation = _clock.syncGeneration();
+	_scheduled = true;
+
+	return true;
+
+}
+
+
+void NodeRedTimeScheduler::nextDue(Job & job, time_t now) const {
+
+	tm local;
+	_zone.localTime(now, &local);
+
+	if (job.period_s > 0) {
+
+		/*
+		 *	Interval job. Work in local seconds since midnight so
+		 *	boundaries follow the local wallclock, then let the zone
+		 *	map the result back to epoch time (resolving daylight
+		 *	saving for that moment).
+		 */
+		long sinceMidnight = 3600L * local.tm_hour + 60L * local.tm_min + local.tm_sec;
+		long base = sinceMidnight - (long)job.offset_s;
+		long steps = (base >= 0) ? base / (long)job.period_s + 1 : 0;
+
+		setLocalTime(local, job.offset_s + steps * job.period_s);
+
+		job.due = _zone.utcTime(&local);
+
+		// a repeated local hour (end of daylight saving) can map backwards
+		if (job.due <= now) {
+			job.due = now + job.period_s - ((now - job.offset_s) % job.period_s);
+		}
+
+		return;
+
+	}
+
+	// time-of-day job: the first matching day from today onwards
+	for (int day = 0; day <= 7; day++) {
+
+		tm candidate = local;
+		candidate.tm_mday += day;
+		setLocalTime(candidate, job.offset_s);
+
+		time_t due = _zone.utcTime(&candidate);
+
+		if (due > now && (job.weekdays & (1 << candidate.tm_wday))) {
+			job.due = due;
+			return;
+		}
+
+	}
+
+}
+
+
+void NodeRedTimeScheduler::setLocalTime(tm & local, unsigned long sinceMidnight_s) {
+
+	/*
+	 *	Every field in range except (possibly) tm_mday. Leaving the
+	 *	whole offset in tm_sec would have utcTime() treat it as
+	 *	elapsed time from midnight, which is an hour out on the day
+	 *	daylight saving starts or ends.
+	 */
+	local.tm_mday += sinceMidnight_s / 86400;
+	sinceMidnight_s %= 86400;
+
+	local.tm_hour = sinceMidnight_s / 3600;
+	local.tm_min = (sinceMidnight_s / 60) % 60;
+	local.tm_sec = sinceMidnight_s % 60;
+	local.tm_isdst = -1;
+
+}
+
+
+void NodeRedTimeScheduler::setDue_ms(Job & job, double epoch_ms, unsigned long uptime_ms) {
+
+	// millis() advances at the same rate as synthetic time (due may have passed)
+	job.due_ms = uptime_ms + (long)(1000.0 * job.due - epoch_ms);
+
+}
+
+
+bool NodeRedTimeScheduler::before(uint8_t a, uint8_t b) {
+
+	// wrap-safe comparison of millis() values
+	return (long)(_jobs[_heap[a]].due_ms - _jobs[_heap[b]].due_ms) < 0;
+
+}
+
+
+void NodeRedTimeScheduler::siftDown(uint8_t i) {
+
+	while (true) {
+
+		uint8_t smallest = i;
+		uint8_t left = 2 * i + 1;
+		uint8_t right = 2 * i + 2;
+
+		if (left < _count && before(left, smallest)) smallest = left;
+		if (right < _count && before(right, smallest)) smallest = right;
+
+		if (smallest == i) return;
+
+		uint8_t swap = _heap[i];
+		_heap[i] = _heap[smallest];
+		_heap[smallest] = swap;
+
+		i = smallest;
+
+	}
+
+}
+
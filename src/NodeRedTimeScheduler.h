@@ -0,0 +1,219 @@
+//
+//  NodeRedTimeScheduler.h
+//
+//  Created 2026-10-18.
+//
+
+#pragma once
+
+#include "NodeRedTime.h"
+#include "NodeRedTimeZone.h"
+
+/// @brief maximum number of jobs a NodeRedTimeScheduler can hold.
+#ifndef NODEREDTIME_SCHEDULER_JOBS
+#define NODEREDTIME_SCHEDULER_JOBS 8
+#endif
+
+/*!	@brief Run jobs at wallclock times without per-second polling.
+**
+**	Jobs are registered in wallclock terms (eg "every 5 minutes on the
+**	minute", "07:30 on weekdays") in local time, as defined by the TZ
+**	environment variable or by a NodeRedTimeZone. For each job the scheduler computes the next
+**	wallclock fire time and converts it to a millis() value once, keeping
+**	the jobs in a min-heap ordered by that value. poll() then only has to
+**	compare millis() with the top of the heap.
+**
+**	Fire times are recomputed when NodeRedTime's synchronisation point
+**	changes (see NodeRedTime::syncGeneration()) and after each job fires.
+**	A job already due when the synchronisation point moves still fires,
+**	and a step backwards never fires a job twice for the same time.
+**	Local fire times are resolved with NodeRedTimeZone rather than the C
+**	library, so jobs stay on the local wallclock across daylight-saving
+**	changes without mktime() and its time zone state.
+**
+**	Sample code:
+**	@code{.cpp}
+**	#include <NodeRedTimeScheduler.h>
+**	NodeRedTime nodeRedTime("http://host.domain.com:1880/time/");
+**	NodeRedTimeScheduler scheduler(nodeRedTime);
+**
+**	void takeReading(time_t when) { ... }
+**
+**	void setup() {
+**		...
+**		scheduler.every(300, takeReading);
+**	}
+**
+**	void loop() {
+**		scheduler.poll();
+**	}
+**	@endcode
+**
+**	@remark Requires C++14, as NodeRedTimeZone does.
+*/
+class NodeRedTimeScheduler {
+
+    public:
+
+		/// @brief job callback. Receives the wallclock time the job was due.
+		typedef void (*Callback)(time_t due);
+
+		/// @brief weekday masks for daily() (bit 0 = Sunday, as tm_wday).
+		static const uint8_t EVERY_DAY = 0x7F;
+		static const uint8_t WEEKDAYS = 0x3E;
+		static const uint8_t WEEKENDS = 0x41;
+
+
+		/*!	@brief NodeRedTimeScheduler constructor
+		**
+		**	@param [in] clock the NodeRedTime object which supplies synthetic time.
+		**	Must outlive the scheduler.
+		**
+		**	@return nothing.
+		**/
+		NodeRedTimeScheduler(NodeRedTime & clock);
+
+
+		/*!	@brief NodeRedTimeScheduler constructor for a fixed time zone
+		**
+		**	Local time is that of zone rather than of the TZ environment
+		**	variable.
+		**
+		**	@param [in] clock the NodeRedTime object which supplies synthetic time.
+		**	Must outlive the scheduler.
+		**	@param [in] zone the local time zone. Copied.
+		**
+		**	@return nothing.
+		**/
+		NodeRedTimeScheduler(NodeRedTime & clock, const NodeRedTimeZone & zone);
+
+
+		/*!	@brief Register an interval job aligned to the local wallclock
+		**
+		**	The job fires whenever the local time of day, in seconds since
+		**	midnight, minus offset_s, is a multiple of period_s. For example
+		**	every(300, f) fires at :00, :05, :10 ... and every(3600, f, 900) fires
+		**	at a quarter past each hour.
+		**
+		**	@param [in] period_s interval in seconds (must be non-zero).
+		**	@param [in] callback function to call.
+		**	@param [in] offset_s shift from the aligned boundaries.
+		**
+		**	@return **false** if the scheduler is full or period_s is zero.
+		**/
+		bool every(
+			unsigned long period_s,
+			Callback callback,
+			unsigned long offset_s = 0
+		);
+
+
+		/*!	@brief Register a job at a fixed local time of day
+		**
+		**	@param [in] hour 0..23
+		**	@param [in] minute 0..59
+		**	@param [in] callback function to call.
+		**	@param [in] weekdays mask of days on which to fire (bit 0 = Sunday).
+		**	Defaults to EVERY_DAY.
+		**
+		**	@return **false** if the scheduler is full or the arguments are out
+		**	of range.
+		**/
+		bool daily(
+			uint8_t hour,
+			uint8_t minute,
+			Callback callback,
+			uint8_t weekdays = EVERY_DAY
+		);
+
+
+		/*!	@brief Run any jobs which are due
+		**
+		**	Call from loop(). When nothing is due (and nothing needs recomputing)
+		**	this costs one millis() call and one comparison.
+		**
+		**	@return the number of jobs which fired.
+		**/
+		unsigned int poll();
+
+
+		/*!	@brief Time until the next job is due
+		**
+		**	Useful for choosing how long to delay() or sleep.
+		**
+		**	@return milliseconds until the earliest job (zero if it is already
+		**	due), or ULONG_MAX if no job is scheduled.
+		**/
+		unsigned long msUntilNext();
+
+
+    protected:
+
+		/// @brief a registered job.
+		struct Job {
+			Callback callback;
+			unsigned long period_s;		///< every(): interval. daily(): zero.
+			unsigned long offset_s;		///< every(): offset. daily(): seconds after midnight.
+			uint8_t weekdays;			///< daily(): weekday mask.
+			time_t due;					///< next wallclock fire time (zero until computed)
+			time_t fired;				///< wallclock time it last fired for (zero if never)
+			unsigned long due_ms;		///< millis() value of due
+		};
+
+		/*!	@brief Add a job and schedule it if time is available.
+		**
+		**	@return **false** if the scheduler is full.
+		**/
+		bool add(const Job & job);
+
+		/*!	@brief Recompute every job's fire time from synthetic time.
+		**
+		**	@return **false** if synthetic time is not available.
+		**/
+		bool reschedule();
+
+		/*!	@brief Compute a job's next wallclock fire time after now.
+		**
+		**	@param [in,out] job the job. due is set.
+		**	@param [in] now the current (or just-fired) wallclock time.
+		**/
+		void nextDue(Job & job, time_t now) const;
+
+		/// @brief set local to a wallclock time of day on its date, ready for
+		/// NodeRedTimeZone::utcTime().
+		static void setLocalTime(tm & local, unsigned long sinceMidnight_s);
+
+		/// @brief set a job's due_ms from its due, given the wallclock and
+		/// millis() values for the same moment.
+		static void setDue_ms(Job & job, double epoch_ms, unsigned long uptime_ms);
+
+		/// @brief true if job a fires before job b.
+		bool before(uint8_t a, uint8_t b);
+
+		/// @brief restore the heap property after _heap[i] moves later.
+		void siftDown(uint8_t i);
+
+		/// @brief supplies synthetic time. Initialized by constructor.
+		NodeRedTime & _clock;
+
+		/// @brief local time zone. Re-read from TZ by reschedule() unless
+		/// given to the constructor.
+		NodeRedTimeZone _zone { "UTC0" };
+		bool _followTz = true;
+
+		/// @brief registered jobs, and a min-heap of their indices ordered by
+		/// due_ms.
+		Job _jobs[NODEREDTIME_SCHEDULER_JOBS];
+		uint8_t _heap[NODEREDTIME_SCHEDULER_JOBS];
+		uint8_t _count = 0;
+
+		/// @brief NodeRedTime::syncGeneration() when fire times were last
+		/// computed, and whether they have been computed at all.
+		uint32_t _generation = 0;
+		bool _scheduled = false;
+
+		/// @brief millis() before which reschedule() should not be retried
+		/// after synthetic time was unavailable.
+		unsigned long _retry_ms = 0;
+
+};
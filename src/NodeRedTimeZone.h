@@ -0,0 +1,508 @@
+//
+//  NodeRedTimeZone.h
+//
+//  Created 2026-10-18.
+//
+
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+
+/*!	@brief POSIX time-zone rules, parsed at compile time.
+**
+**	Sketches usually do this:
+**	@code{.cpp}
+**	setenv("TZ", "AEST-10AEDT,M10.1.0,M4.1.0/3", 1);
+**	localtime_r(&epochTime, &timeinfo);
+**	@endcode
+**	which has the C library parse the string at run time, then consult it
+**	again on every conversion. NodeRedTimeZone parses the same string with
+**	a constexpr constructor, so a zone declared **constexpr** is reduced to
+**	a handful of integers by the compiler and a malformed string is a
+**	compile error. Conversion is then integer arithmetic which does not
+**	touch the libc TZ machinery at all.
+**
+**	Sample code:
+**	@code{.cpp}
+**	#include <NodeRedTimeZone.h>
+**	constexpr NodeRedTimeZone sydney("AEST-10AEDT,M10.1.0,M4.1.0/3");
+**	...
+**	tm timeinfo;
+**	sydney.localTime(epochTime, &timeinfo);
+**	@endcode
+**
+**	The full POSIX syntax is understood:
+**	- names alphabetic ("AEST") or quoted ("<+0530>");
+**	- offsets [+|-]hh[:mm[:ss]] (positive = WEST of Greenwich);
+**	- rules Mm.w.d, Jn (1..365, never counting February 29) or n (0..365);
+**	- rule times [+|-]hh[:mm[:ss]], defaulting to 02:00:00, including the
+**	  extended range (-167..167 hours) used by some zones.
+**	A zone with a daylight-saving name but no rules uses the US rules
+**	(M3.2.0,M11.1.0), as the C library does.
+**
+**	Transitions are those of the UTC year, as the C library computes them.
+**
+**	NodeRedTimeScheduler does its local-time arithmetic with this class.
+**
+**	@remark Requires C++14 (relaxed constexpr), which is the default on the
+**	ESP8266 core 3.x and ESP32 core 3.x.
+*/
+class NodeRedTimeZone {
+
+    public:
+
+		/// @brief when daylight saving starts or ends.
+		struct Rule {
+			char kind = 'M';		///< 'M' month.week.day, 'J' Julian (no Feb 29), 'N' zero-based day
+			int month = 0;			///< 'M': 1..12
+			int week = 0;			///< 'M': 1..5 (5 = last)
+			int day = 0;			///< 'M': weekday 0..6 (Sunday = 0). 'J'/'N': day number
+			long time_s = 7200;		///< local time of day (seconds, may be negative or > 24h)
+		};
+
+
+		/*!	@brief NodeRedTimeZone constructor
+		**
+		**	@param [in] tz POSIX TZ string.
+		**
+		**	@remark When the object is **constexpr**, a malformed string fails to
+		**	compile with an error pointing at invalidTimeZoneString(). Otherwise,
+		**	a malformed string yields a zone for which valid() is **false** and
+		**	which behaves as UTC.
+		**/
+		constexpr NodeRedTimeZone(const char * tz) {
+
+			const char * p = tz;
+
+			bool ok = skipName(p);
+			ok = ok && parseOffset(p, &_stdOffset_s);
+
+			// POSIX offsets are west-positive, everything here is east-positive
+			_stdOffset_s = -_stdOffset_s;
+			_dstOffset_s = _stdOffset_s + 3600;
+
+			if (ok && *p) {
+
+				ok = skipName(p);
+				_hasDst = ok;
+
+				// an explicit daylight-saving offset is optional
+				if (ok && *p && *p != ',') {
+					long dst = 0;
+					ok = parseOffset(p, &dst);
+					_dstOffset_s = -dst;
+				}
+
+				if (ok && *p == ',') {
+					ok = parseRule(++p, &_start) && *p == ',' && parseRule(++p, &_end);
+				} else {
+					_start = usRule(3, 2);
+					_end = usRule(11, 1);
+				}
+
+			}
+
+			if (!ok || *p) {
+				invalidTimeZoneString();
+				_stdOffset_s = _dstOffset_s = 0;
+				_hasDst = false;
+				_valid = false;
+			}
+
+		}
+
+
+		/// @brief **false** if the TZ string could not be parsed.
+		constexpr bool valid() const { return _valid; }
+
+		/// @brief **true** if the zone observes daylight saving.
+		constexpr bool hasDst() const { return _hasDst; }
+
+		/// @brief standard-time offset, seconds EAST of UTC.
+		constexpr long standardOffset() const { return _stdOffset_s; }
+
+		/// @brief daylight-saving offset, seconds EAST of UTC.
+		constexpr long daylightOffset() const { return _dstOffset_s; }
+
+
+		/*!	@brief Is daylight saving in effect?
+		**
+		**	@param [in] utc Unix epoch seconds.
+		**
+		**	@return **true** if daylight saving is in effect at utc.
+		**/
+		constexpr bool isDst(time_t utc) const {
+
+			if (!_hasDst) {
+				return false;
+			}
+
+			/*
+			 *	The transitions of the UTC year, as the C library
+			 *	chooses them. Only a rule at the very end or start of
+			 *	the year (eg "permanent" daylight saving) can tell.
+			 */
+			int year = yearOf(floorDiv((long long)utc, 86400));
+
+			// both transitions as UTC instants in that year
+			long long start = transition(year, _start) - _stdOffset_s;
+			long long end = transition(year, _end) - _dstOffset_s;
+
+			return (start < end) ?
+				(utc >= start && utc < end) :		// northern hemisphere
+				!(utc >= end && utc < start);		// southern hemisphere
+
+		}
+
+
+		/*!	@brief Offset from UTC
+		**
+		**	@param [in] utc Unix epoch seconds.
+		**
+		**	@return seconds EAST of UTC in effect at utc.
+		**/
+		constexpr long offsetAt(time_t utc) const {
+
+			return isDst(utc) ? _dstOffset_s : _stdOffset_s;
+
+		}
+
+
+		/*!	@brief Convert to local time (replacement for localtime_r())
+		**
+		**	@param [in] utc Unix epoch seconds.
+		**	@param [out] local broken-down local time. tm_isdst is 1 when daylight
+		**	saving is in effect, otherwise 0.
+		**
+		**	@return local.
+		**/
+		tm * localTime(time_t utc, tm * local) const {
+
+			bool dst = isDst(utc);
+			breakDown((long long)utc + (dst ? _dstOffset_s : _stdOffset_s), local);
+			local->tm_isdst = dst ? 1 : 0;
+			return local;
+
+		}
+
+
+		/*!	@brief Convert from local time (replacement for mktime())
+		**
+		**	As with mktime(), fields may be out of range (eg tm_mday 32 or
+		**	tm_hour -1) and are carried into the larger ones. tm_isdst is
+		**	ignored: a local time which occurs twice (as daylight saving ends)
+		**	gives the earlier instant, and one which never occurs (as it starts)
+		**	is read as standard time, which lands after the transition.
+		**
+		**	@param [in,out] local broken-down local time. Normalised on return,
+		**	with tm_wday, tm_yday and tm_isdst filled in.
+		**
+		**	@return Unix epoch seconds.
+		**/
+		time_t utcTime(tm * local) const {
+
+			// months beyond 0..11 carry into the year
+			long long years = floorDiv(local->tm_mon, 12);
+			int year = local->tm_year + 1900 + years;
+			int month = local->tm_mon - years * 12 + 1;
+
+			long long seconds =
+				(daysFromCivil(year, month, 1) + local->tm_mday - 1) * 86400 +
+				local->tm_hour * 3600LL + local->tm_min * 60LL + local->tm_sec;
+
+			// the reading in each offset is only right if that offset applies then
+			long long standard = seconds - _stdOffset_s;
+			long long daylight = seconds - _dstOffset_s;
+			bool standardFits = !isDst(standard);
+			bool daylightFits = isDst(daylight);
+
+			long long utc = (daylightFits && (!standardFits || daylight < standard)) ? daylight : standard;
+
+			localTime(utc, local);
+			return utc;
+
+		}
+
+
+		/*!	@brief Convert to UTC broken-down time (replacement for gmtime_r())
+		**
+		**	@param [in] utc Unix epoch seconds.
+		**	@param [out] t broken-down UTC time (tm_isdst = 0).
+		**
+		**	@return t.
+		**/
+		static tm * breakDown(long long utc, tm * t) {
+
+			long long days = floorDiv(utc, 86400);
+			long seconds = utc - days * 86400;
+
+			int year = 0, month = 0, day = 0;
+			civilFromDays(days, &year, &month, &day);
+
+			t->tm_year = year - 1900;
+			t->tm_mon = month - 1;
+			t->tm_mday = day;
+			t->tm_hour = seconds / 3600;
+			t->tm_min = (seconds / 60) % 60;
+			t->tm_sec = seconds % 60;
+			t->tm_wday = weekday(days);
+			t->tm_yday = days - daysFromCivil(year, 1, 1);
+			t->tm_isdst = 0;
+
+			return t;
+
+		}
+
+
+		/*!	@brief Days since 1970-01-01 of a proleptic Gregorian date
+		**
+		**	(H. Hinnant's days_from_civil algorithm.)
+		**
+		**	@param [in] year full year (eg 2026).
+		**	@param [in] month 1..12
+		**	@param [in] day 1..31
+		**
+		**	@return days since 1970-01-01 (negative before then).
+		**/
+		static constexpr long long daysFromCivil(int year, int month, int day) {
+
+			year -= month <= 2;
+			long long era = floorDiv(year, 400);
+			long yoe = year - era * 400;
+			long doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+			long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+			return era * 146097 + doe - 719468;
+
+		}
+
+
+		/// @brief inverse of daysFromCivil().
+		static constexpr void civilFromDays(long long days, int * year, int * month, int * day) {
+
+			days += 719468;
+			long long era = floorDiv(days, 146097);
+			long doe = days - era * 146097;
+			long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+			long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+			long mp = (5 * doy + 2) / 153;
+
+			*day = doy - (153 * mp + 2) / 5 + 1;
+			*month = mp < 10 ? mp + 3 : mp - 9;
+			*year = yoe + era * 400 + (*month <= 2);
+
+		}
+
+
+		/// @brief day of the week (Sunday = 0) of days since 1970-01-01.
+		static constexpr int weekday(long long days) {
+
+			// 1970-01-01 was a Thursday
+			return (int)(floorDiv(days + 4, 7) * -7 + days + 4);
+
+		}
+
+
+		/// @brief true if year is a leap year.
+		static constexpr bool isLeap(int year) {
+
+			return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+
+		}
+
+
+		/*!	@brief Local time of a transition
+		**
+		**	@param [in] year full year.
+		**	@param [in] rule the transition.
+		**
+		**	@return seconds since 1970-01-01T00:00:00 in the local time which was
+		**	in effect just before the transition.
+		**/
+		static constexpr long long transition(int year, const Rule & rule) {
+
+			long long days = daysFromCivil(year, 1, 1);
+
+			if (rule.kind == 'J') {
+
+				// 1..365, February 29 never counted
+				days += rule.day - 1 + ((isLeap(year) && rule.day >= 60) ? 1 : 0);
+
+			} else if (rule.kind == 'N') {
+
+				// 0..365, February 29 counted
+				days += rule.day;
+
+			} else {
+
+				// the given weekday in the given week of the month
+				long long first = daysFromCivil(year, rule.month, 1);
+				int length = (rule.month == 12) ? 31 : daysFromCivil(year, rule.month + 1, 1) - first;
+				int mday = 1 + (rule.day - weekday(first) + 7) % 7 + (rule.week - 1) * 7;
+
+				// week 5 means "last", which may be the fourth
+				while (mday > length) {
+					mday -= 7;
+				}
+
+				days = first + mday - 1;
+
+			}
+
+			return days * 86400 + rule.time_s;
+
+		}
+
+
+    protected:
+
+		/// @brief standard and daylight-saving offsets, seconds EAST of UTC.
+		long _stdOffset_s = 0;
+		long _dstOffset_s = 0;
+
+		/// @brief daylight-saving start and end (meaningful if _hasDst).
+		Rule _start;
+		Rule _end;
+
+		bool _hasDst = false;
+		bool _valid = true;
+
+		/*!	@brief Deliberately not constexpr.
+		**
+		**	Reaching this during constant evaluation makes the constructor call
+		**	ill-formed, so a malformed TZ string in a **constexpr** zone is
+		**	reported by the compiler, with this function named in the error.
+		**/
+		static void invalidTimeZoneString() { }
+
+		/// @brief floor division (rounds towards negative infinity).
+		static constexpr long long floorDiv(long long a, long long b) {
+			return (a >= 0) ? a / b : -((-a + b - 1) / b);
+		}
+
+		/// @brief year containing days since 1970-01-01.
+		static constexpr int yearOf(long long days) {
+			int year = 0, month = 0, day = 0;
+			civilFromDays(days, &year, &month, &day);
+			return year;
+		}
+
+		/// @brief first Sunday on or after 02:00 - the US default rules.
+		static constexpr Rule usRule(int month, int week) {
+			Rule rule;
+			rule.month = month;
+			rule.week = week;
+			return rule;
+		}
+
+		static constexpr bool isDigit(char c) {
+			return c >= '0' && c <= '9';
+		}
+
+		static constexpr bool isAlpha(char c) {
+			return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+		}
+
+		/// @brief unsigned decimal number within min..max.
+		static constexpr bool parseNumber(const char * & p, long min, long max, long * value) {
+			if (!isDigit(*p)) {
+				return false;
+			}
+			long n = 0;
+			while (isDigit(*p)) {
+				n = n * 10 + (*p++ - '0');
+				if (n > max) {
+					return false;
+				}
+			}
+			*value = n;
+			return n >= min;
+		}
+
+		/// @brief zone name: at least three letters, or <...>.
+		static constexpr bool skipName(const char * & p) {
+			int length = 0;
+			if (*p == '<') {
+				p++;
+				while (*p && *p != '>') {
+					p++;
+					length++;
+				}
+				if (*p++ != '>') {
+					return false;
+				}
+			} else {
+				while (isAlpha(*p)) {
+					p++;
+					length++;
+				}
+			}
+			return length >= 3;
+		}
+
+		/// @brief [+|-]hh[:mm[:ss]] in seconds, hours within 0..maxHours.
+		static constexpr bool parseTime(const char * & p, long maxHours, long * seconds) {
+			long sign = 1;
+			if (*p == '+' || *p == '-') {
+				sign = (*p++ == '-') ? -1 : 1;
+			}
+			long hours = 0, minutes = 0, secs = 0;
+			if (!parseNumber(p, 0, maxHours, &hours)) {
+				return false;
+			}
+			if (*p == ':') {
+				if (!parseNumber(++p, 0, 59, &minutes)) {
+					return false;
+				}
+				if (*p == ':' && !parseNumber(++p, 0, 59, &secs)) {
+					return false;
+				}
+			}
+			*seconds = sign * (hours * 3600 + minutes * 60 + secs);
+			return true;
+		}
+
+		/// @brief UTC offset (POSIX sign convention).
+		static constexpr bool parseOffset(const char * & p, long * seconds) {
+			return parseTime(p, 24, seconds);
+		}
+
+		/// @brief Mm.w.d, Jn or n, optionally followed by /time.
+		static constexpr bool parseRule(const char * & p, Rule * rule) {
+			long a = 0, b = 0, c = 0;
+			if (*p == 'M') {
+				p++;
+				if (!(
+					parseNumber(p, 1, 12, &a) && *p++ == '.' &&
+					parseNumber(p, 1, 5, &b) && *p++ == '.' &&
+					parseNumber(p, 0, 6, &c)
+				)) {
+					return false;
+				}
+				rule->kind = 'M';
+				rule->month = a;
+				rule->week = b;
+				rule->day = c;
+			} else if (*p == 'J') {
+				p++;
+				if (!parseNumber(p, 1, 365, &a)) {
+					return false;
+				}
+				rule->kind = 'J';
+				rule->day = a;
+			} else {
+				if (!parseNumber(p, 0, 365, &a)) {
+					return false;
+				}
+				rule->kind = 'N';
+				rule->day = a;
+			}
+			rule->time_s = 7200;
+			if (*p == '/') {
+				return parseTime(++p, 167, &rule->time_s);
+			}
+			return true;
+		}
+
+};
@@ -0,0 +1,98 @@
+//
+//  NodeRedTimeZoneTable.cpp
+//
+//  Created 2026-10-18.
+//
+
+#include "NodeRedTimeZoneTable.h"
+
+NodeRedTimeZoneTable::NodeRedTimeZoneTable(
+	const Transition * table,
+	const size_t count
+) : _table(table), _count(count) {
+
+	_index = 0;
+	_current = entry(0);
+	_next_min = (_count > 1) ? entry(1).at_min : INT64_MAX;
+
+}
+
+
+NodeRedTimeZoneTable::Transition NodeRedTimeZoneTable::entry(size_t i) const {
+
+	Transition result;
+	memcpy_P(&result, &_table[i], sizeof(Transition));
+	return result;
+
+}
+
+
+void NodeRedTimeZoneTable::seek(int64_t at_min) {
+
+	// the usual case - still within the entry found last time
+	if (at_min >= _current.at_min && at_min < _next_min) {
+		return;
+	}
+
+	// the next most likely case - time has moved into the following entry
+	size_t found = _index;
+
+	if (at_min >= _next_min && (_index + 2 >= _count || at_min < entry(_index + 2).at_min)) {
+
+		found = _index + 1;
+
+	} else {
+
+		// otherwise binary search for the last entry at or before at_min
+		size_t low = 0, high = _count;
+
+		while (high - low > 1) {
+			size_t mid = low + (high - low) / 2;
+			if (entry(mid).at_min <= at_min) {
+				low = mid;
+			} else {
+				high = mid;
+			}
+		}
+
+		found = low;
+
+	}
+
+	_index = found;
+	_current = entry(found);
+	_next_min = (found + 1 < _count) ? entry(found + 1).at_min : INT64_MAX;
+
+}
+
+
+long NodeRedTimeZoneTable::offsetAt(time_t utc) {
+
+	// floor to whole minutes so instants before 1970 round correctly
+	int64_t at_s = utc;
+	seek((at_s >= 0) ? at_s / 60 : -((-at_s + 59) / 60));
+
+	return 60L * _current.offset_min;
+
+}
+
+
+bool NodeRedTimeZoneTable::isDst(time_t utc) {
+
+	offsetAt(utc);
+
+	return _current.isDst;
+
+}
+
+
+tm * NodeRedTimeZoneTable::localTime(time_t utc, tm * local) {
+
+	// gmtime_r() does no time-zone processing of its own
+	time_t shifted = utc + offsetAt(utc);
+	gmtime_r(&shifted, local);
+	local->tm_isdst = _current.isDst;
+
+	return local;
+
+}
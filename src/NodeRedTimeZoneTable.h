@@ -0,0 +1,116 @@
+//
+//  NodeRedTimeZoneTable.h
+//
+//  Created 2026-10-18.
+//
+
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+
+/*!	@brief Local time from a pre-computed table of zone transitions.
+**
+**	A POSIX TZ string can only describe a zone's current rules, so local
+**	times before the most recent rule change come out wrong, and every
+**	conversion re-evaluates "M10.1.0"-style rules with calendar arithmetic.
+**
+**	Instead, extras/NodeRedTime_ZoneTable/generate_zone_table.py turns an
+**	IANA zone (eg "Australia/Sydney") into a sorted PROGMEM table of
+**	transitions over a range of years. Conversion is then a table lookup:
+**	the index of the last transition is remembered, so the usual case
+**	(time moving forwards) is one or two comparisons, and anything else is
+**	a binary search.
+**
+**	Sample code:
+**	@code{.cpp}
+**	#include <NodeRedTimeZoneTable.h>
+**	#include "Australia_Sydney.h"
+**	NodeRedTimeZoneTable sydney(Australia_Sydney, Australia_Sydney_Count);
+**	...
+**	tm timeinfo;
+**	sydney.localTime(epochTime, &timeinfo);
+**	@endcode
+**
+**	@remark Outside the table's range of years the nearest entry's offset
+**	applies, so generate a range which covers the device's service life.
+**	The generator also emits the zone's POSIX TZ string, which can be given
+**	to NodeRedTimeZone for times past the end of the table.
+*/
+class NodeRedTimeZoneTable {
+
+    public:
+
+		/// @brief one entry in a generated table (8 bytes).
+		struct Transition {
+			int32_t at_min;			///< UTC instant the offset takes effect, minutes since the Unix epoch
+			int16_t offset_min;		///< offset EAST of UTC from then on, minutes
+			uint8_t isDst;			///< 1 if the offset is daylight saving
+			uint8_t reserved;		///< always zero
+		};
+
+
+		/*!	@brief NodeRedTimeZoneTable constructor
+		**
+		**	@param [in] table a generated table (may be in PROGMEM). The first
+		**	entry (at INT32_MIN) gives the offset before the first transition.
+		**	Must outlive this object.
+		**
+		**	@param [in] count number of entries in the table (at least one).
+		**
+		**	@return nothing.
+		**/
+		NodeRedTimeZoneTable(const Transition * table, const size_t count);
+
+
+		/*!	@brief Offset from UTC
+		**
+		**	@param [in] utc Unix epoch seconds.
+		**
+		**	@return seconds EAST of UTC in effect at utc.
+		**/
+		long offsetAt(time_t utc);
+
+
+		/*!	@brief Is daylight saving in effect?
+		**
+		**	@param [in] utc Unix epoch seconds.
+		**
+		**	@return **true** if daylight saving is in effect at utc.
+		**/
+		bool isDst(time_t utc);
+
+
+		/*!	@brief Convert to local time (replacement for localtime_r())
+		**
+		**	@param [in] utc Unix epoch seconds.
+		**	@param [out] local broken-down local time, with tm_isdst set from the
+		**	table.
+		**
+		**	@return local.
+		**/
+		tm * localTime(time_t utc, tm * local) __attribute__((nonnull));
+
+
+    protected:
+
+		/// @brief the table and its length
+		const Transition * _table;
+		size_t _count;
+
+		/// @brief index of the entry found by the last lookup
+		size_t _index = 0;
+
+		/// @brief that entry, copied out of PROGMEM
+		Transition _current;
+
+		/// @brief instant the entry after _current takes effect (minutes)
+		int64_t _next_min;
+
+		/// @brief copy entry i out of PROGMEM
+		Transition entry(size_t i) const;
+
+		/// @brief make _current the entry in effect at minute at_min
+		void seek(int64_t at_min);
+
+};